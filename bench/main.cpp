@@ -0,0 +1,440 @@
+// microbenchmarks for the world query and navigation primitives, driven offline against real maps
+// usage: xclient_bench <game_dir> [map ...] [--nav-dir <dir>] [--seed <n>] [--queries <n>]
+//
+// every map is loaded from <game_dir>/maps/<map>.bsp, growth starts from the first area of
+// <nav-dir>/<map>.nav (assets/navigations by default), results are printed as json lines:
+// {"map":"de_dust2","case":"trace_line","param":2048,"iterations":4096,"ns_per_op":812.4,"areas":1530,"checksum":...,"expansions":0.0,"allocations":0.0}
+// allocations per op are counted when configured with -DBUILD_ALLOCATION_STATS=ON, they are 0 otherwise
+
+#include <navigator.h>
+#include <allocation_stats.h>
+#include <chrono>
+#include <algorithm>
+#include <limits>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <functional>
+
+static const float EyeHeight = 64.0f;
+static const std::vector<float> GrowRadiuses = { 512.0f, 1024.0f, 2048.0f };
+static const int MaxGrowPasses = 16;
+
+struct Options
+{
+	std::string game_dir;
+	std::string nav_dir = "assets/navigations";
+	std::vector<std::string> maps;
+	uint32_t seed = 1;
+	int queries = 4096;
+};
+
+struct Result
+{
+	std::string map;
+	std::string name;
+	float param = 0.0f;
+	int iterations = 0;
+	double ns_per_op = 0.0;
+	size_t areas = 0;
+	double checksum = 0.0; // keeps the compiler from dropping the measured work, also handy to spot nondeterminism
+	double expansions = 0.0; // per op, planner cases only
+};
+
+static double LastAllocations = 0.0; // per op of the last Measure
+
+static void PrintResult(const Result& result)
+{
+	std::printf("{\"map\":\"%s\",\"case\":\"%s\",\"param\":%.0f,\"iterations\":%d,\"ns_per_op\":%.1f,\"areas\":%zu,\"checksum\":%.3f,\"expansions\":%.1f,\"allocations\":%.1f}\n",
+		result.map.c_str(), result.name.c_str(), result.param, result.iterations, result.ns_per_op, result.areas, result.checksum, result.expansions, LastAllocations);
+	std::fflush(stdout);
+}
+
+static double Measure(int iterations, const std::function<void(int)>& func)
+{
+	auto allocations = AllocationStats::GetThreadCount();
+	auto begin = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < iterations; i++)
+		func(i);
+
+	auto end = std::chrono::steady_clock::now();
+	LastAllocations = (double)(AllocationStats::GetThreadCount() - allocations) / (double)std::max(iterations, 1);
+	auto ns = std::chrono::duration<double, std::nano>(end - begin).count();
+	return ns / (double)std::max(iterations, 1);
+}
+
+template <typename T>
+static bool ReadValue(std::ifstream& file, T& value)
+{
+	return (bool)file.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+// reads only the header of a source engine style .nav file and returns the center of its first area,
+// which is a known walkable spot, so we do not need any spawn entity parsing here
+
+static std::optional<glm::vec3> ReadFirstNavAreaCenter(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+
+	if (!file)
+		return std::nullopt;
+
+	uint32_t magic = 0;
+	uint32_t version = 0;
+
+	if (!ReadValue(file, magic) || !ReadValue(file, version) || magic != 0xFEEDFACE)
+		return std::nullopt;
+
+	uint32_t skip32 = 0;
+	uint8_t skip8 = 0;
+
+	if (version >= 10)
+		ReadValue(file, skip32); // subversion
+
+	if (version >= 4)
+		ReadValue(file, skip32); // bsp size
+
+	if (version >= 14)
+		ReadValue(file, skip8); // analyzed
+
+	uint16_t places_count = 0;
+	ReadValue(file, places_count);
+
+	for (uint16_t i = 0; i < places_count; i++)
+	{
+		uint16_t length = 0;
+		ReadValue(file, length);
+		file.seekg(length, std::ios::cur);
+	}
+
+	if (version >= 12)
+		ReadValue(file, skip8); // has unnamed areas
+
+	uint32_t areas_count = 0;
+	uint32_t area_id = 0;
+
+	if (!ReadValue(file, areas_count) || areas_count == 0 || !ReadValue(file, area_id))
+		return std::nullopt;
+
+	if (version <= 8)
+		file.seekg(1, std::ios::cur);
+	else if (version <= 12)
+		file.seekg(2, std::ios::cur);
+	else
+		file.seekg(4, std::ios::cur);
+
+	glm::vec3 lo;
+	glm::vec3 hi;
+
+	if (!ReadValue(file, lo) || !ReadValue(file, hi))
+		return std::nullopt;
+
+	return (lo + hi) * 0.5f;
+}
+
+static void RunMap(const Options& options, const std::string& map)
+{
+	auto bsp_path = options.game_dir + "/maps/" + map + ".bsp";
+	auto nav_path = options.nav_dir + "/" + map + ".nav";
+
+	if (!std::filesystem::exists(bsp_path))
+	{
+		std::fprintf(stderr, "xclient_bench: %s not found, skipping\n", bsp_path.c_str());
+		return;
+	}
+
+	auto start = ReadFirstNavAreaCenter(nav_path);
+
+	if (!start.has_value())
+	{
+		std::fprintf(stderr, "xclient_bench: no start point for %s (%s), skipping\n", map.c_str(), nav_path.c_str());
+		return;
+	}
+
+	Navigator navigator;
+	navigator.loadBsp(bsp_path);
+
+	auto step = navigator.getNavStep();
+	auto origin = start.value() + glm::vec3{ 0.0f, 0.0f, EyeHeight };
+	origin.x = origin.x - glm::mod(origin.x, step);
+	origin.y = origin.y - glm::mod(origin.y, step);
+
+	auto ground = navigator.getGroundFromOrigin(origin);
+
+	if (!ground.has_value())
+	{
+		std::fprintf(stderr, "xclient_bench: start point of %s is inside solid, skipping\n", map.c_str());
+		return;
+	}
+
+	auto& nav_mesh = navigator.getNavMesh();
+
+	auto get_areas_count = [&] {
+		return nav_mesh.getExploredAreas().size() + nav_mesh.getUnexploredAreas().size();
+	};
+
+	// growth, from an empty mesh up to everything reachable within the radius
+
+	for (auto radius : GrowRadiuses)
+	{
+		nav_mesh.clear();
+		navigator.setNavExploreDistance(radius);
+
+		int passes = 0;
+
+		auto ns = Measure(1, [&](int) {
+			while (passes < MaxGrowPasses)
+			{
+				passes += 1;
+				nav_mesh.collectExploredAreas();
+
+				if (navigator.buildNavMesh(ground.value(), origin) == Navigator::BuildNavMeshStatus::Finished)
+					break;
+			}
+			nav_mesh.collectExploredAreas();
+		});
+
+		LastAllocations /= passes;
+		PrintResult({ map, "build_nav_mesh", radius, passes, ns / passes, get_areas_count(), (double)nav_mesh.getExploredAreas().size() });
+	}
+
+	// queries, against the biggest mesh from above
+
+	const auto& areas = nav_mesh.getExploredAreas();
+
+	if (areas.size() < 2)
+	{
+		std::fprintf(stderr, "xclient_bench: mesh of %s is too small for queries, skipping\n", map.c_str());
+		return;
+	}
+
+	auto radius = GrowRadiuses.back();
+	auto areas_count = get_areas_count();
+
+	std::mt19937 random(options.seed);
+	std::uniform_int_distribution<size_t> area_dist(0, areas.size() - 1);
+	std::uniform_real_distribution<float> jitter_dist(-step * 2.0f, step * 2.0f);
+
+	std::vector<std::pair<NavArea*, NavArea*>> pairs(options.queries);
+
+	for (auto& [a, b] : pairs)
+	{
+		a = areas.at(area_dist(random));
+		b = areas.at(area_dist(random));
+	}
+
+	std::vector<glm::vec3> points(options.queries);
+
+	for (auto& point : points)
+		point = areas.at(area_dist(random))->position + glm::vec3{ jitter_dist(random), jitter_dist(random), 0.0f };
+
+	auto eye = glm::vec3{ 0.0f, 0.0f, EyeHeight };
+
+	double checksum = 0.0;
+	auto ns = Measure(options.queries, [&](int i) {
+		auto [a, b] = pairs[i];
+		checksum += navigator.traceLine(a->position + eye, b->position + eye).fraction;
+	});
+	PrintResult({ map, "trace_line", radius, options.queries, ns, areas_count, checksum });
+
+	checksum = 0.0;
+	ns = Measure(options.queries, [&](int i) {
+		auto [a, b] = pairs[i];
+		checksum += navigator.traceHull(a->position + eye, b->position + eye, BspHull::Stand).fraction;
+	});
+	PrintResult({ map, "trace_hull", radius, options.queries, ns, areas_count, checksum });
+
+	checksum = 0.0;
+	ns = Measure(options.queries, [&](int i) {
+		auto point = navigator.getGroundFromOrigin(points[i] + eye);
+		checksum += point.has_value() ? point.value().z : 0.0f;
+	});
+	PrintResult({ map, "get_ground_from_origin", radius, options.queries, ns, areas_count, checksum });
+
+	checksum = 0.0;
+	ns = Measure(options.queries, [&](int i) {
+		auto area = NavMesh::FindNearestArea(areas, points[i]);
+		checksum += area != nullptr ? area->position.x : 0.0f;
+	});
+	PrintResult({ map, "find_nearest_area", radius, options.queries, ns, areas_count, checksum });
+
+	checksum = 0.0;
+	ns = Measure(options.queries, [&](int i) {
+		auto area = NavMesh::FindExactArea(areas, pairs[i].first->position, step * 1.25f);
+		checksum += area != nullptr ? area->position.x : 0.0f;
+	});
+	PrintResult({ map, "find_exact_area", radius, options.queries, ns, areas_count, checksum });
+
+	checksum = 0.0;
+	ns = Measure(options.queries, [&](int i) {
+		auto area = nav_mesh.findExactArea(pairs[i].first->position, step * 1.25f);
+		checksum += area != nullptr ? area->position.x : 0.0f;
+	});
+	PrintResult({ map, "find_exact_area_tiled", radius, options.queries, ns, areas_count, checksum });
+
+	// path queries are much heavier, so only a slice of the pairs, they run over merged regions
+
+	ns = Measure(1, [&](int) {
+		nav_mesh.updateRegions(std::numeric_limits<size_t>::max());
+	});
+	PrintResult({ map, "update_regions", radius, 1, ns, areas_count, (double)nav_mesh.getRegionsCount() });
+
+	auto chain_queries = std::max(options.queries / 16, 1);
+
+	// a* over regions against jump point search over the grid, same pairs
+
+	for (auto jump_points : { false, true })
+	{
+		navigator.setNavJumpPoints(jump_points);
+		navigator.resetCounters();
+
+		checksum = 0.0;
+		ns = Measure(chain_queries, [&](int i) {
+			auto [a, b] = pairs[i];
+			checksum += (double)navigator.buildNavChain(a, b).size();
+		});
+
+		auto expansions = (double)navigator.getCounters().expansions / (double)chain_queries;
+		PrintResult({ map, jump_points ? "build_nav_chain_jps" : "build_nav_chain", radius, chain_queries, ns, areas_count, checksum, expansions });
+	}
+
+	// the link in the middle of the longest straight walk of a chain gets stuck on twice (blocked),
+	// its regions are split again and the chain is planned anew, it has to go around now.
+	// checksum counts the chains that do, runs last because penalties stay on the mesh
+
+	navigator.setNavJumpPoints(false);
+	navigator.resetCounters();
+
+	auto get_link_towards = [](NavArea* area, const glm::vec3& towards) -> NavArea* {
+		NavArea* result = nullptr;
+		float best_dot = 0.0f;
+
+		for (auto dir : Directions)
+		{
+			auto neighbour = area->getNeighbour(dir);
+
+			if (neighbour == nullptr)
+				continue;
+
+			auto dot = glm::dot(glm::normalize(neighbour->position - area->position), glm::normalize(towards - area->position));
+
+			if (dot <= best_dot)
+				continue;
+
+			result = neighbour;
+			best_dot = dot;
+		}
+
+		return result;
+	};
+
+	auto is_crossing = [&](const NavChain& chain, const glm::vec3& point) {
+		for (size_t i = 1; i < chain.size(); i++)
+		{
+			auto a = glm::vec2{ chain[i - 1].position.x, chain[i - 1].position.y };
+			auto line = glm::vec2{ chain[i].position.x, chain[i].position.y } - a;
+			auto p = glm::vec2{ point.x, point.y };
+			auto length_sq = glm::dot(line, line);
+			auto t = length_sq > 0.0f ? glm::clamp(glm::dot(p - a, line) / length_sq, 0.0f, 1.0f) : 0.0f;
+
+			if (glm::distance(p, a + line * t) < step * 0.25f)
+				return true;
+		}
+
+		return false;
+	};
+
+	checksum = 0.0;
+	ns = Measure(chain_queries, [&](int i) {
+		auto [a, b] = pairs[i];
+		auto chain = navigator.buildNavChain(a, b);
+
+		// waypoints are reversed, the walk goes from back() to front()
+		size_t longest = 0;
+
+		for (size_t j = 1; j < chain.size(); j++)
+		{
+			if (glm::distance(chain[j - 1].position, chain[j].position) > glm::distance(chain[longest].position, chain[longest + 1].position))
+				longest = j - 1;
+		}
+
+		if (chain.size() < 2 || glm::distance(chain[longest].position, chain[longest + 1].position) < step * 4.0f)
+			return;
+
+		auto towards = chain[longest].position;
+		auto from = (chain[longest].position + chain[longest + 1].position) * 0.5f;
+		auto area = NavMesh::FindNearestArea(areas, from);
+		auto neighbour = get_link_towards(area, towards);
+
+		if (neighbour == nullptr)
+			return;
+
+		navigator.penalizeNavLink(from, towards);
+		navigator.penalizeNavLink(from, towards);
+		nav_mesh.updateRegions(std::numeric_limits<size_t>::max());
+
+		if (!is_crossing(navigator.buildNavChain(a, b), (area->position + neighbour->position) * 0.5f))
+			checksum += 1.0;
+	});
+
+	auto expansions = (double)navigator.getCounters().expansions / (double)chain_queries;
+	PrintResult({ map, "build_nav_chain_penalized", radius, chain_queries, ns, areas_count, checksum, expansions });
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "--nav-dir" && i + 1 < argc)
+			options.nav_dir = argv[++i];
+		else if (arg == "--seed" && i + 1 < argc)
+			options.seed = (uint32_t)std::stoul(argv[++i]);
+		else if (arg == "--queries" && i + 1 < argc)
+			options.queries = std::max(std::stoi(argv[++i]), 1);
+		else if (options.game_dir.empty())
+			options.game_dir = arg;
+		else
+			options.maps.push_back(arg);
+	}
+
+	if (options.game_dir.empty())
+	{
+		std::fprintf(stderr, "usage: xclient_bench <game_dir> [map ...] [--nav-dir <dir>] [--seed <n>] [--queries <n>]\n");
+		return 1;
+	}
+
+	// without explicit maps we take every map we have a start point for
+
+	if (options.maps.empty())
+	{
+		std::error_code ec;
+
+		for (const auto& entry : std::filesystem::directory_iterator(options.game_dir + "/maps", ec))
+		{
+			if (entry.path().extension() != ".bsp")
+				continue;
+
+			auto map = entry.path().stem().string();
+
+			if (std::filesystem::exists(options.nav_dir + "/" + map + ".nav"))
+				options.maps.push_back(map);
+		}
+
+		std::sort(options.maps.begin(), options.maps.end());
+	}
+
+	for (const auto& map : options.maps)
+		RunMap(options, map);
+
+	return 0;
+}
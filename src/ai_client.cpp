@@ -1,70 +1,30 @@
 #include "ai_client.h"
+#include "allocation_stats.h"
 #include <HL/utils.h>
 #include <common/helpers.h>
+#include <sstream>
+#include <charconv>
+#include <cstdlib>
 
-bool NavArea::isExplored() const
-{
-	return neighbours.size() == Directions.size();
-}
-
-bool NavArea::isBorder() const
-{
-	assert(isExplored());
-
-	for (auto dir : Directions)
-	{
-		auto neighbour = neighbours.at(dir);
-
-		if (neighbour.has_value() && neighbour.value().lock()->isExplored())
-			continue;
-
-		return true;
-	}
-
-	return false;
-}
-
-bool NavArea::isNeighbour(std::shared_ptr<NavArea> area) const
-{
-	for (auto [dir, neighbour] : neighbours)
-	{
-		if (!neighbour.has_value())
-			continue;
-
-		if (neighbour.value().lock() != area)
-			continue;
-
-		return true;
-	}
+// console input is typed by hand, parse it without throwing
 
-	return false;
-}
-
-std::shared_ptr<NavArea> NavMesh::FindNearestArea(const AreaSet& areas, const glm::vec3& pos)
+static std::optional<int> ParseInt(const std::string& text)
 {
-	float min_distance = 8192.0f;
-	std::shared_ptr<NavArea> result = nullptr;
-	for (auto area : areas)
-	{
-		auto distance = glm::distance(pos, area->position);
-		if (distance < min_distance)
-		{
-			result = area;
-			min_distance = distance;
-		}
-	}
+	int result = 0;
+	auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), result);
+	if (error != std::errc() || end != text.data() + text.size())
+		return std::nullopt;
 	return result;
 }
 
-std::shared_ptr<NavArea> NavMesh::FindExactArea(const AreaSet& areas, const glm::vec3& pos, float tolerance)
+static std::optional<float> ParseFloat(const std::string& text)
 {
-	for (auto area : areas)
-	{
-		auto distance = glm::distance(pos, area->position);
-		if (distance <= tolerance)
-			return area;
-	}
-	return nullptr;
+	// floating point from_chars is missing on older libc++
+	char* end = nullptr;
+	auto result = std::strtof(text.c_str(), &end);
+	if (text.empty() || end != text.c_str() + text.size())
+		return std::nullopt;
+	return result;
 }
 
 AiClient::AiClient()
@@ -75,54 +35,192 @@ AiClient::AiClient()
 		think(cmd);
 	});
 
+	mThinkExecutor.setFailureCallback([](const std::string& name, const std::string& what) {
+		HL::Utils::dlog("think task {} failed: {}", name, what);
+	});
+
 	setResourceRequiredCallback([this](const HL::Protocol::Resource& resource) -> bool {
 		const auto& info = getServerInfo().value();
 
 		if (resource.name == info.map)
-			return true;
+		{
+			MapStore::Hash hash;
+			std::copy_n(std::begin(resource.hash), hash.size(), hash.begin());
+
+			if (!MapStore::IsValidHash(hash))
+				return true;
+
+			mMapHash = hash;
+			mStoredMapPath = MapStore::Find(hash);
+
+			// a verified copy is already on this machine, the server does not have to upload it again
+			return !mStoredMapPath.has_value();
+		}
 
 		return false;
 	});
 
 	CONSOLE->registerCommand("nav_clear", "clear navmesh", [this](CON_ARGS){
-		mNavMesh.explored_areas.clear();
-		mNavMesh.unexplored_areas.clear();
+		// the mesh is shared by every bot of this map, all of them start over. the think logic clears it on the next tick
+		mNavClearPending = true;
 	});
 
-	CONSOLE->registerCVar("nav_explore_distance", { "float" }, CVAR_GETTER_FLOAT(mNavExploreDistance), CVAR_SETTER_FLOAT(mNavExploreDistance));
-	CONSOLE->registerCVar("nav_step", { "float" }, CVAR_GETTER_FLOAT(mNavStep), CVAR_SETTER_FLOAT(mNavStep));
+	CONSOLE->registerCommand("flight_dump", "write recent think ticks to a file", { "path" }, { "seconds" }, [this](CON_ARGS){
+		auto seconds = args.size() > 1 ? ParseFloat(args[1]) : FlightDumpSeconds;
+		if (!seconds.has_value())
+		{
+			CONSOLE->writeLine("cannot parse " + args[1]);
+			return;
+		}
+		std::lock_guard lock(mThinkMutex);
+		if (!mFlightRecorder.dump(args[0], Clock::FromSeconds(seconds.value())))
+			CONSOLE->writeLine("cannot write " + args[0]);
+	});
+
+	// cvars the think logic reads are written under the think mutex, the worker holds it for a whole tick
+	auto locked = [this](auto setter) {
+		return [this, setter](CON_ARGS) {
+			std::lock_guard lock(mThinkMutex);
+			setter(args);
+		};
+	};
+
+	CONSOLE->registerCVar("nav_explore_distance", { "float" }, CVAR_GETTER_FLOAT(mNavExploreDistance), locked(CVAR_SETTER_FLOAT(mNavExploreDistance)));
+	CONSOLE->registerCVar("nav_step", { "float" }, CVAR_GETTER_FLOAT(mNavStep), [this](CON_ARGS) {
+		// the mesh of the current map is shared with other bots, its step is fixed
+		auto step = ParseFloat(args[0]);
+		if (!step.has_value() || step.value() <= 0.0f)
+		{
+			CONSOLE->writeLine("cannot parse " + args[0]);
+			return;
+		}
+		setNavStep(step.value());
+		if (mNavStep != getNavStep())
+			CONSOLE->writeLine("nav_step applies from the next map");
+	});
+	CONSOLE->registerCVar("ai_think_rate", { "float" }, CVAR_GETTER_FLOAT(mThinkRate), CVAR_SETTER_FLOAT(mThinkRate));
+	CONSOLE->registerCVar("nav_mesh_rate", { "float" }, CVAR_GETTER_FLOAT(mNavMeshRate), locked(CVAR_SETTER_FLOAT(mNavMeshRate)));
+	CONSOLE->registerCVar("nav_chain_rate", { "float" }, CVAR_GETTER_FLOAT(mNavChainRate), locked(CVAR_SETTER_FLOAT(mNavChainRate)));
+	CONSOLE->registerCVar("ai_task_budget", { "float" }, CVAR_GETTER_FLOAT(mTaskBudgetMilliseconds), locked(CVAR_SETTER_FLOAT(mTaskBudgetMilliseconds)));
+	CONSOLE->registerCVar("nav_tile_budget", { "int" }, CVAR_GETTER_INT(mNavTileBudget), locked(CVAR_SETTER_INT(mNavTileBudget)));
+	CONSOLE->registerCVar("nav_jps", { "bool" }, CVAR_GETTER_BOOL(mNavJumpPoints), locked(CVAR_SETTER_BOOL(mNavJumpPoints)));
+	CONSOLE->registerCVar("nav_flow_fields", { "bool" }, CVAR_GETTER_BOOL(mUseFlowFields), locked(CVAR_SETTER_BOOL(mUseFlowFields)));
+	CONSOLE->registerCVar("ai_thread", { "bool" }, CVAR_GETTER_BOOL(mUseThinkThread), CVAR_SETTER_BOOL(mUseThinkThread));
+	CONSOLE->registerCVar("ai_show_stats", { "bool" }, CVAR_GETTER_BOOL(mShowStats), CVAR_SETTER_BOOL(mShowStats));
+	CONSOLE->registerCVar("metrics_port", { "int" }, [] {
+		return std::vector<std::string>{ std::to_string(Metrics::GetPort()) };
+	}, [](CON_ARGS) {
+		auto port = ParseInt(args[0]);
+		if (!port.has_value() || port.value() < 0 || port.value() > 65535 || !Metrics::Listen((uint16_t)port.value()))
+			CONSOLE->writeLine("cannot listen on port " + args[0]);
+	});
+	CONSOLE->registerCVar("nav_stream_port", { "int" }, [this] {
+		std::lock_guard lock(mThinkMutex);
+		return std::vector<std::string>{ std::to_string(mNavStream.getPort()) };
+	}, [this](CON_ARGS) {
+		auto port = ParseInt(args[0]);
+		std::lock_guard lock(mThinkMutex);
+		if (!port.has_value() || port.value() < 0 || port.value() > 65535 || !mNavStream.listen((uint16_t)port.value()))
+			CONSOLE->writeLine("cannot listen on port " + args[0]);
+	});
+	CONSOLE->registerCVar("map_prewarm_size", { "int" }, [] {
+		return std::vector<std::string>{ std::to_string(MapPrewarm::GetCapacity()) };
+	}, [](CON_ARGS) {
+		auto capacity = ParseInt(args[0]);
+		if (!capacity.has_value())
+		{
+			CONSOLE->writeLine("cannot parse " + args[0]);
+			return;
+		}
+		MapPrewarm::SetCapacity((size_t)std::max(capacity.value(), 0));
+	});
+	CONSOLE->registerCVar("map_cycle", { "maps" }, [] {
+		std::string result;
+		for (const auto& map : MapPrewarm::GetCycle())
+			result += (result.empty() ? "" : " ") + map;
+		return std::vector<std::string>{ result };
+	}, [](CON_ARGS) {
+		std::vector<std::string> maps;
+		std::istringstream stream(args[0]);
+		std::string map;
+		while (stream >> map)
+			maps.push_back(map);
+		MapPrewarm::SetCycle(maps);
+	});
 }
 
 AiClient::~AiClient()
 {
 	CONSOLE->removeCommand("nav_clear");
+	CONSOLE->removeCommand("flight_dump");
 	CONSOLE->removeCVar("nav_explore_distance");
 	CONSOLE->removeCVar("nav_step");
+	CONSOLE->removeCVar("ai_think_rate");
+	CONSOLE->removeCVar("nav_mesh_rate");
+	CONSOLE->removeCVar("nav_chain_rate");
+	CONSOLE->removeCVar("ai_task_budget");
+	CONSOLE->removeCVar("nav_tile_budget");
+	CONSOLE->removeCVar("nav_jps");
+	CONSOLE->removeCVar("nav_flow_fields");
+	CONSOLE->removeCVar("ai_thread");
+	CONSOLE->removeCVar("ai_show_stats");
+	CONSOLE->removeCVar("metrics_port");
+	CONSOLE->removeCVar("nav_stream_port");
+	CONSOLE->removeCVar("map_prewarm_size");
+	CONSOLE->removeCVar("map_cycle");
+
+	stopThinkThread();
+	Metrics::RemoveSeries(mMetricsLabels);
 }
 
 void AiClient::onFrame()
 {
-	auto origin = getOrigin();
-	const auto& clientdata = getClientData();
+	// nothing below is needed by the bot itself, we only format what is displayed
+	if (!mShowStats)
+		return;
 
-	GAME_STATS("explored areas", mNavMesh.explored_areas.size());
-	GAME_STATS("unexplored areas", mNavMesh.unexplored_areas.size());
+	// live state, onFrame runs on the network thread
+	WorldSnapshot world;
+	world.client_data = getClientData();
+
+	auto origin = world.getOrigin();
+	const auto& clientdata = world.client_data;
+
+	GAME_STATS("explored areas", (size_t)mExploredAreasMetric.get());
+	GAME_STATS("unexplored areas", (size_t)mUnexploredAreasMetric.get());
+	GAME_STATS("nav tiles", fmt::format("{:.0f} resident, {:.0f} paged", mResidentTilesMetric.get(), mPagedTilesMetric.get()));
+	GAME_STATS("nav regions", (size_t)mNavRegionsMetric.get());
+	GAME_STATS("flow fields", (size_t)mFlowFieldsMetric.get());
+	GAME_STATS("nav visibility", fmt::format("{:.0f} clusters, {:.0f} pending", mVisibilityClustersMetric.get(), mVisibilityPendingMetric.get()));
+	GAME_STATS("stuck", fmt::format("{} times, {:.1f}s", mStuckMetric.get(), mStuckMillisecondsMetric.get() / 1000.0f));
+	GAME_STATS("think time", fmt::format("p50 {:.2f} ms, p99 {:.2f} ms", mThinkTimeMetric.getQuantile(0.5) * 1000.0, mThinkTimeMetric.getQuantile(0.99) * 1000.0));
 	GAME_STATS("origin", fmt::format("{:.0f} {:.0f} {:.0f}", origin.x, origin.y, origin.z));
 	GAME_STATS("flags", clientdata.flags);
 	GAME_STATS("maxspeed", fmt::format("{:.0f}", clientdata.maxspeed));
-	GAME_STATS("alive", isAlive());
-	GAME_STATS("health", fmt::format("{:.0f}", getHealth()));
-	GAME_STATS("spectator", isSpectator());
-	GAME_STATS("on_ground", isOnGround());
-	GAME_STATS("ducking", isDucking());
-	GAME_STATS("speed", fmt::format("{:.0f}", getSpeed()));
+	GAME_STATS("alive", world.isAlive());
+	GAME_STATS("health", fmt::format("{:.0f}", world.getHealth()));
+	GAME_STATS("spectator", world.isSpectator());
+	GAME_STATS("on_ground", world.isOnGround());
+	GAME_STATS("ducking", world.isDucking());
+	GAME_STATS("speed", fmt::format("{:.0f}", world.getSpeed()));
 	GAME_STATS("deadflag", clientdata.deadflag);
+	GAME_STATS("think thread", mThinkThread.joinable());
+	GAME_STATS("map from store", mMapFromStore);
+
+	auto prewarm = MapPrewarm::GetCounters();
+	GAME_STATS("map prewarm", fmt::format("{} hits, {} misses, {} cached, {} nav meshes", prewarm.hits, prewarm.misses, prewarm.cached, prewarm.nav_meshes));
+
+	if (AllocationStats::IsEnabled())
+		GAME_STATS("think allocations", (uint64_t)mThinkAllocationsMetric.get());
 }
 
 void AiClient::initializeGameEngine()
 {
 	PlayableClient::initializeGameEngine();
 	mThinkTime = Clock::Now();
+	mThinkScheduler.reset();
+	mNavMeshScheduler.reset();
+	mNavChainScheduler.reset();
 }
 
 void AiClient::initializeGame()
@@ -130,7 +228,39 @@ void AiClient::initializeGame()
 	PlayableClient::initializeGame();
 
 	const auto& info = getServerInfo().value();
-    mBspFile.loadFromFile(info.game_dir + "/" + info.map, false);
+	auto map_path = std::filesystem::path(info.game_dir) / info.map;
+	mMapFromStore = mStoredMapPath.has_value();
+
+	if (mStoredMapPath.has_value())
+		map_path = mStoredMapPath.value();
+	else if (mMapHash.has_value())
+		MapPrewarm::Store(mMapHash.value(), map_path); // first bot to download a map shares it with the rest
+
+	// the mesh belongs to the content of the map. without an announced hash we take the one the prewarm
+	// computed, and only when there is none either the mesh goes by the map name
+	auto map_hash = mMapHash;
+
+	mMapHash.reset();
+	mStoredMapPath.reset();
+
+	if (auto prepared = MapPrewarm::Take(info.map, map_path); prepared != nullptr)
+	{
+		if (!map_hash.has_value())
+			map_hash = prepared->hash;
+
+		setBsp(std::move(prepared->bsp_file), std::move(prepared->bsp_hulls));
+	}
+	else
+	{
+		loadBsp(map_path.string());
+	}
+
+	setNavMesh(SharedNavMesh::Acquire(info.map, map_hash, mNavStep));
+
+	if (mNavMesh->getStep() != mNavStep)
+		CONSOLE->writeLine(fmt::format("nav_step is {} on {}, its mesh is shared with other bots", mNavMesh->getStep(), info.map));
+
+	MapPrewarm::OnMapStarted(info.map, map_path, info.game_dir);
 
 	CONSOLE->execute("later 1 'cmd \"jointeam 2\"'");
 	CONSOLE->execute("later 2 'cmd \"joinclass 6\"'");
@@ -140,10 +270,25 @@ void AiClient::resetGameResources()
 {
 	HL::PlayableClient::resetGameResources();
 
+	// the worker must not touch the bsp or the mesh while the map changes
+	stopThinkThread();
+
+	// the shared mesh stays with the other bots of this map, we just let go of it.
+	// when the map comes again in the cycle the prewarm keeps the mesh for our return
+	mNavMesh->releaseFrontier(mNavOwner);
+	auto nav_mesh = mNavMesh;
+	setNavMesh(std::make_shared<SharedNavMesh>());
+	MapPrewarm::KeepNavMesh(std::move(nav_mesh));
 	mNavChain.clear();
-	mNavMesh.explored_areas.clear();
-	mNavMesh.unexplored_areas.clear();
-	mCustomMoveTarget.reset();
+	mInfluence.clear();
+	mWaypointProgress.reset();
+	mStuckLinks.clear();
+	mNavClearPending = false;
+	setCustomMoveTarget(std::nullopt);
+	mThinkExecutor.cancelAll(); // whatever they were doing was about the old map
+
+	std::lock_guard lock(mThinkMutex);
+	mNavStream.reset(); // viewers forget the old map
 }
 
 void AiClient::think(HL::Protocol::UserCmd& cmd)
@@ -153,14 +298,87 @@ void AiClient::think(HL::Protocol::UserCmd& cmd)
 	mThinkTime = now;
 
 	cmd.msec = Clock::ToMilliseconds(delta);
-	cmd.forwardmove = 0.0f;
-	cmd.sidemove = 0.0f;
-	cmd.upmove = 0.0f;
-	cmd.buttons = 0;
+
+	// think runs every frame, but the world is copied only when a think tick is due
+	if (mThinkScheduler.isDue(now, mThinkRate))
+		captureWorld(now, mThinkScheduler.getDelta());
+
+	if (mUseThinkThread)
+	{
+		startThinkThread();
+	}
+	else
+	{
+		stopThinkThread();
+
+		if (mWorldBuffer.update())
+			thinkTick(mWorldBuffer.getReadBuffer());
+	}
+
+	while (auto think_cmd = mThinkCmds.pop())
+		mThinkCmd = think_cmd.value();
+
+	// between think ticks (or while the worker is busy) we keep repeating the last decision
+	cmd.forwardmove = mThinkCmd.forwardmove;
+	cmd.sidemove = mThinkCmd.sidemove;
+	cmd.upmove = mThinkCmd.upmove;
+	cmd.buttons = mThinkCmd.buttons;
+	cmd.viewangles = mThinkCmd.viewangles;
+}
+
+void AiClient::captureWorld(Clock::TimePoint now, Clock::Duration delta)
+{
+	auto& world = mWorldBuffer.getWriteBuffer();
+	world.time = now;
+	world.delta = delta;
+	world.client_data = getClientData();
+	world.move_vars = getMoveVars();
+	captureEntities(world.entities);
+	mWorldBuffer.publish();
+
+	mWorldSerial.fetch_add(1, std::memory_order_release);
+	mWorldSerial.notify_one();
+}
+
+void AiClient::thinkTick(const WorldSnapshot& world)
+{
+	std::lock_guard lock(mThinkMutex);
+
+	auto tick_start = Clock::Now();
+
+	mWorld = &world;
+	mMovementBranch = FlightRecordFormat::Branch::None;
+	mNavMeshTime = Clock::Duration::zero();
+	resetCounters();
+
+	auto allocations = AllocationStats::GetThreadCount();
+
+	if (mNavClearPending.exchange(false))
+	{
+		std::unique_lock nav_lock(mNavMesh->getMutex());
+		mNavMesh->clear();
+	}
+
+	// whoever cleared the mesh, what we built on top of it is gone
+	if (auto generation = mNavMesh->getGeneration(); generation != mNavGeneration)
+	{
+		mNavGeneration = generation;
+		mNavChain.clear();
+		mInfluence.clear();
+		mStuckLinks.clear();
+		mWaypointProgress.reset();
+		mThinkExecutor.cancelAll();
+		mNavStream.reset();
+	}
+
+	HL::Protocol::UserCmd cmd = {};
 	cmd.viewangles = mPrevViewAngles;
 
 	synchronizeBspModel();
+
+	auto movement_start = Clock::Now();
 	movement(cmd);
+	auto movement_end = Clock::Now();
 
 	if (mWantJump && (isOnGround() || isOnLadder()))
 	{
@@ -185,15 +403,128 @@ void AiClient::think(HL::Protocol::UserCmd& cmd)
 	{
 		mLastAirTime = Clock::Now();
 	}
+
+	mThinkCmds.push(cmd);
+	{
+		std::shared_lock nav_lock(mNavMesh->getMutex());
+		mExploredAreasMetric.set((double)mNavMesh->getExploredAreas().size());
+		mUnexploredAreasMetric.set((double)mNavMesh->getUnexploredAreas().size());
+		mResidentTilesMetric.set((double)mNavMesh->getResidentTilesCount());
+		mPagedTilesMetric.set((double)mNavMesh->getPagedTilesCount());
+		mVisibilityClustersMetric.set((double)mNavMesh->getVisibility().getClustersCount());
+		mVisibilityPendingMetric.set((double)mNavMesh->getVisibility().getPendingCount());
+		mNavRegionsMetric.set((double)mNavMesh->getRegionsCount());
+		mFlowFieldsMetric.set((double)mNavMesh->getFlowFieldsCount());
+	}
+	mThinkAllocationsMetric.set((double)(AllocationStats::GetThreadCount() - allocations));
+	recordThinkTick(cmd, tick_start, movement_start, movement_end);
+
+	if (mNavStream.getPort() != 0 && mNavStreamScheduler.isDue(tick_start, NavStreamRate))
+		streamThinkTick();
+
+	mWorld = nullptr;
 }
 
-void AiClient::synchronizeBspModel()
+void AiClient::streamThinkTick()
 {
-	mBspModelIndices.clear();
+	NavStreamFormat::Tick tick;
+	tick.record = mFlightRecorder.getLast();
+	tick.explored_areas = (uint32_t)mExploredAreasMetric.get();
+	tick.unexplored_areas = (uint32_t)mUnexploredAreasMetric.get();
+	tick.resident_tiles = (uint32_t)mResidentTilesMetric.get();
+	tick.paged_tiles = (uint32_t)mPagedTilesMetric.get();
+	tick.stuck_count = (uint32_t)mStuckMetric.get();
+
+	std::shared_lock nav_lock(mNavMesh->getMutex());
+	mNavStream.update(*mNavMesh, mNavChain, tick);
+}
+
+void AiClient::recordThinkTick(const HL::Protocol::UserCmd& cmd, Clock::TimePoint tick_start, Clock::TimePoint movement_start, Clock::TimePoint movement_end)
+{
+	auto origin = getOrigin();
+
+	FlightRecordFormat::Record record;
+	record.origin[0] = origin.x;
+	record.origin[1] = origin.y;
+	record.origin[2] = origin.z;
+	record.speed = getSpeed();
+	record.health = getHealth();
+	record.state = 0;
+	if (isAlive())
+		record.state |= FlightRecordFormat::Alive;
+	if (isOnGround())
+		record.state |= FlightRecordFormat::OnGround;
+	if (isDucking())
+		record.state |= FlightRecordFormat::Ducking;
+	if (isSpectator())
+		record.state |= FlightRecordFormat::Spectator;
+	record.players = (uint8_t)std::min<size_t>(mWorld->entities.getPlayers().size(), 255);
+	record.branch = (uint8_t)mMovementBranch;
+	record.reserved = 0;
+	record.chain_length = (uint16_t)std::min<size_t>(mNavChain.size(), 65535);
+	record.buttons = (uint16_t)cmd.buttons;
+	record.traces = getCounters().traces;
+	record.expansions = getCounters().expansions;
+	record.forwardmove = cmd.forwardmove;
+	record.sidemove = cmd.sidemove;
+	record.upmove = cmd.upmove;
+	record.viewangles[0] = cmd.viewangles.x;
+	record.viewangles[1] = cmd.viewangles.y;
+	record.nav_mesh_time = (uint32_t)Clock::ToMicroseconds(mNavMeshTime);
+	record.movement_time = (uint32_t)Clock::ToMicroseconds(movement_end - movement_start - mNavMeshTime);
+	record.tick_time = (uint32_t)Clock::ToMicroseconds(Clock::Now() - tick_start);
+	mFlightRecorder.record(record);
+
+	mThinkTicksMetric.add();
+	mTracesMetric.add(record.traces);
+	mExpansionsMetric.add(record.expansions);
+	mThinkTimeMetric.observe(record.tick_time / 1000000.0);
+	mNavMeshTimeMetric.observe(record.nav_mesh_time / 1000000.0);
+	mMovementTimeMetric.observe(record.movement_time / 1000000.0);
+}
+
+void AiClient::startThinkThread()
+{
+	if (mThinkThread.joinable())
+		return;
+
+	mThinkThreadRunning = true;
+	mThinkThread = std::thread([this] {
+		auto serial = mWorldSerial.load(std::memory_order_acquire);
+
+		while (mThinkThreadRunning)
+		{
+			mWorldSerial.wait(serial, std::memory_order_acquire);
+			serial = mWorldSerial.load(std::memory_order_acquire);
+
+			if (mWorldBuffer.update())
+				thinkTick(mWorldBuffer.getReadBuffer());
+		}
+	});
+}
+
+void AiClient::stopThinkThread()
+{
+	if (!mThinkThread.joinable())
+		return;
+
+	mThinkThreadRunning = false;
+	mWorldSerial.fetch_add(1, std::memory_order_release);
+	mWorldSerial.notify_one();
+	mThinkThread.join();
+}
+
+void AiClient::captureEntities(EntitySnapshot& entities)
+{
+	entities.clear();
+
 	for (auto [index, entity] : getEntities())
 	{
 		if (isPlayerIndex(index))
+		{
+			entities.addPlayer(index, *entity);
 			continue;
+		}
 
 		auto model = findModel(entity->modelindex);
 
@@ -205,10 +536,19 @@ void AiClient::synchronizeBspModel()
 		if (!name.starts_with("*"))
 			continue;
 
-		auto bsp_model_index = std::stoi(name.substr(1));
+		entities.addBrushModel(index, std::stoi(name.substr(1)), entity->origin);
+	}
 
-		mBspModelIndices.insert(bsp_model_index);
-		mBspFile.setModelOrigin(bsp_model_index, entity->origin);
+	entities.buildPlayerGrid();
+}
+
+void AiClient::synchronizeBspModel()
+{
+	mBspModelIndices.clear();
+	for (const auto& model : mWorld->entities.getBrushModels())
+	{
+		mBspModelIndices.insert(model.bsp_model_index);
+		setBspModelOrigin(model.bsp_model_index, model.origin);
 	}
 }
 
@@ -216,22 +556,64 @@ void AiClient::movement(HL::Protocol::UserCmd& cmd)
 {
 	if (!isAlive())
 		return;
-		
-	buildNavMesh();
+
+	if (!mThinkExecutor.isRunning(NavMeshTaskName))
+		mThinkExecutor.spawn(NavMeshTaskName, growNavMesh());
+
+	// multi-tick work takes its own nav locks, so it runs before we take ours
+	mThinkExecutor.tick(Clock::FromSeconds(mTaskBudgetMilliseconds / 1000.0f));
+
+	// other bots may grow the mesh concurrently, everything below only reads it
+	std::shared_lock nav_lock(mNavMesh->getMutex());
+
+	updateInfluence();
+
+	mMovementBranch = FlightRecordFormat::Branch::AvoidPlayers;
 
 	if (avoidOtherPlayers(cmd) == MovementStatus::Processing)
 		return;
 
+	mMovementBranch = FlightRecordFormat::Branch::CustomTarget;
+
 	if (moveToCustomTarget(cmd) == MovementStatus::Processing)
 		return;
 
+	mMovementBranch = FlightRecordFormat::Branch::Explore;
+
 	if (exploreNewAreas(cmd) == MovementStatus::Processing)
 		return;
+
+	mMovementBranch = FlightRecordFormat::Branch::None;
+}
+
+void AiClient::updateInfluence()
+{
+	// only the areas under the players we see are touched, the rest of the map decays on its own.
+	// a player we lost sight of keeps fading out where we saw them last
+
+	auto origin = getOrigin();
+
+	for (const auto& player : mWorld->entities.getPlayers())
+	{
+		if (glm::distance(player.origin, origin) < 1.0f)
+			continue; // that is us
+
+		if (!isVisibleCached(origin, player.origin))
+			continue;
+
+		auto ground = player.origin - glm::vec3{ 0.0f, 0.0f, PlayerOriginZStand };
+		auto area = mNavMesh->findExactArea(ground, getNavStep());
+
+		if (area == nullptr)
+			continue;
+
+		mInfluence.stamp(area, 1.0f, mWorld->time);
+	}
 }
 
 glm::vec3 AiClient::getOrigin() const
 {
-	return getClientData().origin;
+	return mWorld->getOrigin();
 }
 
 glm::vec3 AiClient::getAngles() const
@@ -246,59 +628,16 @@ glm::vec3 AiClient::getFootOrigin() const
 	return origin;
 }
 
-std::optional<glm::vec3> AiClient::getGroundFromOrigin(const glm::vec3& origin) const
+std::optional<const HL::Protocol::Entity*> AiClient::findNearestVisiblePlayerEntity()
 {
-	auto start_pos = origin;
-	auto end_pos = start_pos - glm::vec3{ 0.0f, 0.0f, MaxDistance };
-	auto trace = traceLine(start_pos, end_pos);
-
-	if (trace.start_solid)
-		return std::nullopt;
-
-	return trace.endpos;
-}
-
-std::optional<glm::vec3> AiClient::getRoofFromOrigin(const glm::vec3& origin) const
-{
-	auto start_pos = origin;
-	auto end_pos = start_pos + glm::vec3{ 0.0f, 0.0f, MaxDistance };
-	auto trace = traceLine(start_pos, end_pos);
+	auto player = mWorld->entities.findNearestPlayer(getOrigin(), MaxDistance, [this](const EntitySnapshot::Player& player) {
+		return isVisibleCached(getOrigin(), player.origin);
+	});
 
-	if (trace.start_solid)
+	if (player == nullptr)
 		return std::nullopt;
 
-	return trace.endpos;
-}
-
-std::optional<HL::Protocol::Entity*> AiClient::findNearestVisiblePlayerEntity()
-{
-	std::optional<HL::Protocol::Entity*> result;
-	auto min_distance = MaxDistance;
-
-	for (const auto& [index, entity] : getEntities())
-	{
-		if (!isPlayerIndex(index))
-			continue;
-
-		if (!isVisible(*entity))
-			continue;
-
-		auto distance = getDistance(*entity);
-
-		if (distance < min_distance)
-		{
-			min_distance = distance;
-			result = entity;
-		}
-	}
-
-	return result;
-}
-
-bool AiClient::isVisible(const glm::vec3& eye, const glm::vec3& target) const
-{
-	auto result = traceLine(eye, target);
-	return result.fraction >= 1.0f;
+	return &player->entity;
 }
 
 bool AiClient::isVisible(const glm::vec3& target) const
@@ -313,33 +652,27 @@ bool AiClient::isVisible(const HL::Protocol::Entity& entity) const
 
 bool AiClient::isOnGround() const
 {
-	auto flags = getClientData().flags;
-	return flags & FL_ONGROUND;
+	return mWorld->isOnGround();
 }
 
 bool AiClient::isAlive() const
 {
-	return
-		!isSpectator() &&
-		(getHealth() > 0.0f) &&
-		(getClientData().deadflag == DEAD_NO);
+	return mWorld->isAlive();
 }
 
 bool AiClient::isSpectator() const
 {
-	auto flags = getClientData().flags;
-	return flags & FL_SPECTATOR;
+	return mWorld->isSpectator();
 }
 
 bool AiClient::isOnLadder() const
 {
-	return false; // TODO
+	return isInLadder(getOrigin(), getCurrentHull());
 }
 
 bool AiClient::isDucking() const
 {
-	auto flags = getClientData().flags;
-	return flags & FL_DUCKING;
+	return mWorld->isDucking();
 }
 
 bool AiClient::isTired() const
@@ -349,7 +682,7 @@ bool AiClient::isTired() const
 
 float AiClient::getHealth() const
 {
-	return getClientData().health;
+	return mWorld->getHealth();
 }
 
 float AiClient::getCurrentHeight() const
@@ -360,6 +693,14 @@ float AiClient::getCurrentHeight() const
 		return PlayerHeightStand;
 }
 
+BspHull AiClient::getCurrentHull() const
+{
+	if (isDucking())
+		return BspHull::Duck;
+	else
+		return BspHull::Stand;
+}
+
 float AiClient::getCurrentEyeHeight() const
 {
 	if (isDucking())
@@ -370,7 +711,7 @@ float AiClient::getCurrentEyeHeight() const
 
 float AiClient::getSpeed() const
 {
-	return glm::length(getClientData().velocity);
+	return mWorld->getSpeed();
 }
 
 float AiClient::getDistance(const glm::vec3& target) const
@@ -385,10 +726,7 @@ float AiClient::getDistance(const HL::Protocol::Entity& entity) const
 
 void AiClient::moveTo(HL::Protocol::UserCmd& cmd, const glm::vec3& target, bool walk) const
 {
-	float speed = getClientData().maxspeed;
-
-	if (speed <= 0.0f)
-		speed = getMoveVars().value().max_speed;
+	float speed = mWorld->getMaxSpeed();
 
 	if (walk && !isDucking())
 		speed *= WalkSpeedMultiplier;
@@ -399,7 +737,10 @@ void AiClient::moveTo(HL::Protocol::UserCmd& cmd, const glm::vec3& target, bool
 
 	cmd.forwardmove = glm::cos(glm::radians(angle)) * speed;
 	cmd.sidemove = glm::sin(glm::radians(angle)) * speed;
-	cmd.buttons |= IN_FORWARD; // TODO: this is for ladders, it seems we should refactor moveTo approach
+
+	// ladder movement reads the buttons, not forwardmove
+	if (isOnLadder())
+		cmd.buttons |= cmd.forwardmove >= 0.0f ? IN_FORWARD : IN_BACK;
 }
 
 void AiClient::moveTo(HL::Protocol::UserCmd& cmd, const HL::Protocol::Entity& entity, bool walk) const
@@ -428,8 +769,10 @@ void AiClient::lookAt(HL::Protocol::UserCmd& cmd, const glm::vec3& target) const
 	viewangles.y = (float)glm::degrees(glm::atan(v.y, v.x));
 	viewangles.z = 0.0f;
 
-	cmd.viewangles.x = sky::ease_towards(cmd.viewangles.x, viewangles.x, Clock::FromMilliseconds(cmd.msec));
-	cmd.viewangles.y = glm::degrees(sky::ease_rotation_towards(glm::radians(cmd.viewangles.y), glm::radians(viewangles.y), Clock::FromMilliseconds(cmd.msec)));
+	auto delta = mWorld->delta;
+
+	cmd.viewangles.x = sky::ease_towards(cmd.viewangles.x, viewangles.x, delta);
+	cmd.viewangles.y = glm::degrees(sky::ease_rotation_towards(glm::radians(cmd.viewangles.y), glm::radians(viewangles.y), delta));
 	cmd.viewangles.z = 0.0f;
 }
 
@@ -454,18 +797,11 @@ void AiClient::duck()
 	mWantDuck = true;
 }
 
-AiClient::TraceResult AiClient::traceLine(const glm::vec3& begin, const glm::vec3& end) const
+AiClient::MovementStatus AiClient::trivialMoveTo(HL::Protocol::UserCmd& cmd, const glm::vec3& target, bool allow_walk, std::optional<NavTraversal> traversal)
 {
-	auto r = mBspFile.traceLine(begin, end, mBspModelIndices);
-	TraceResult result;
-	result.endpos = r.endpos;
-	result.fraction = r.fraction;
-	result.start_solid = r.startsolid;
-	return result;
-}
+	if (traversal == NavTraversal::Ladder)
+		return climbLadderTo(cmd, target);
 
-AiClient::MovementStatus AiClient::trivialMoveTo(HL::Protocol::UserCmd& cmd, const glm::vec3& target, bool allow_walk)
-{
 	const glm::vec3 eye_target = { target.x, target.y, getOrigin().z };
 
 	auto distance = getDistance(eye_target);
@@ -475,7 +811,10 @@ AiClient::MovementStatus AiClient::trivialMoveTo(HL::Protocol::UserCmd& cmd, con
 
 	lookAt(cmd, eye_target);
 
-	trivialAvoidVerticalObstacles(cmd, target);
+	if (traversal.has_value())
+		followNavTraversal(cmd, target, traversal.value());
+	else
+		trivialAvoidVerticalObstacles(cmd, target);
 
 	if (trivialAvoidWallCorners(cmd, target) == MovementStatus::Processing)
 		return MovementStatus::Processing;
@@ -489,94 +828,82 @@ AiClient::MovementStatus AiClient::trivialMoveTo(HL::Protocol::UserCmd& cmd, con
 
 AiClient::MovementStatus AiClient::trivialAvoidWallCorners(HL::Protocol::UserCmd& cmd, const glm::vec3& target)
 {
-	const auto origin = getOrigin();
-	const auto direction = glm::normalize(target - origin);
+	// sweep our own hull ahead at step height, when it touches a wall we slide along it
 
-	auto left_direction = glm::cross(direction, { 0.0f, 0.0f, -1.0f });
-	auto right_direction = glm::cross(direction, { 0.0f, 0.0f, 1.0f });
+	const auto origin = getOrigin() + glm::vec3{ 0.0f, 0.0f, StepHeight };
+	const auto direction = glm::normalize(glm::vec3{ target.x - origin.x, target.y - origin.y, 0.0f });
 
-	const auto origin_left = origin + (left_direction * PlayerWidth * 0.5f);
-	const auto origin_left_forward = origin_left + (direction * PlayerWidth * 1.5f);
+	auto trace = traceHull(origin, origin + (direction * PlayerWidth * 1.5f), getCurrentHull());
 
-	const auto origin_right = origin + (right_direction * PlayerWidth * 0.5f);
-	const auto origin_right_forward = origin_right + (direction * PlayerWidth * 1.5f);
+	if (trace.start_solid || trace.fraction >= 1.0f)
+		return MovementStatus::Finished;
 
-	auto visible_left = isVisible(origin_left, origin_left_forward);
-	auto visible_right = isVisible(origin_right, origin_right_forward);
-	
-	if (!visible_left && visible_right)
-	{
-		moveTo(cmd, origin_right);
-		return MovementStatus::Processing;
-	}
-	else if (visible_left && !visible_right)
-	{
-		moveTo(cmd, origin_left);
-		return MovementStatus::Processing;
-	}
-	
-	return MovementStatus::Finished;
+	auto normal = glm::vec3{ trace.plane_normal.x, trace.plane_normal.y, 0.0f };
+
+	if (glm::length(normal) <= 0.0f)
+		return MovementStatus::Finished; // floor or roof, not a corner
+
+	normal = glm::normalize(normal);
+
+	auto slide = direction - (normal * glm::dot(direction, normal));
+
+	if (glm::length(slide) < 0.1f)
+		return MovementStatus::Finished; // facing the wall, nothing to slide along
+
+	moveTo(cmd, getOrigin() + (glm::normalize(slide) * PlayerWidth));
+	return MovementStatus::Processing;
 }
 
 AiClient::MovementStatus AiClient::trivialAvoidVerticalObstacles(HL::Protocol::UserCmd& cmd, const glm::vec3& target)
 {
+	// one step ahead: a standing hull passes, a ducking hull passes, or a ducking hull passes after a jump
+
 	const auto foot_origin = getFootOrigin();
 	const glm::vec3 foot_target = { target.x, target.y, foot_origin.z };
+	const auto step = glm::normalize(foot_target - foot_origin) * PlayerWidth;
 
-	const auto direction = glm::normalize(foot_target - foot_origin);
-	const auto foot_next_pos = foot_origin + (direction * PlayerWidth);
-
-	struct Window
-	{
-		glm::vec3 ground;
-		glm::vec3 roof;
-	};
+	const auto stand_origin = foot_origin + glm::vec3{ 0.0f, 0.0f, PlayerOriginZStand + StepHeight };
 
-	std::optional<Window> window;
+	if (traceHull(stand_origin, stand_origin + step, BspHull::Stand).fraction >= 1.0f)
+		return MovementStatus::Finished;
 
-	float search_z_offset = 0.0f;
+	const auto duck_origin = foot_origin + glm::vec3{ 0.0f, 0.0f, PlayerOriginZDuck + StepHeight };
 
-	while (true)
+	if (traceHull(duck_origin, duck_origin + step, BspHull::Duck).fraction >= 1.0f)
 	{
-		auto search_origin = foot_next_pos + glm::vec3{ 0.0f, 0.0f, search_z_offset };
-		auto ground = getGroundFromOrigin(search_origin);
-
-		if (ground.has_value())
-		{
-			auto step_height = ground.value().z - foot_next_pos.z;
-
-			if (step_height > JumpCrouchHeight)
-				break;
-
-			auto roof = getRoofFromOrigin(search_origin);
-			auto window_height = glm::distance(ground.value(), roof.value());
-			if (window_height >= PlayerHeightDuck)
-			{
-				window = Window{ ground.value(), roof.value() };
-				break;
-			}
-		}
+		duck();
+		return MovementStatus::Processing;
+	}
 
-		if (search_z_offset > JumpCrouchHeight)
-			break;
+	const auto jump_origin = foot_origin + glm::vec3{ 0.0f, 0.0f, PlayerOriginZDuck + JumpCrouchHeight };
 
-		search_z_offset += PlayerHeightDuck;
+	if (traceHull(duck_origin, jump_origin, BspHull::Duck).fraction >= 1.0f && traceHull(jump_origin, jump_origin + step, BspHull::Duck).fraction >= 1.0f)
+	{
+		jump(true);
+		return MovementStatus::Processing;
 	}
 
-	if (!window.has_value())
-		return MovementStatus::Finished;
+	return MovementStatus::Finished;
+}
 
-	auto ground_next_pos = window.value().ground;
-	auto roof_next_pos = window.value().roof;
+AiClient::MovementStatus AiClient::followNavTraversal(HL::Protocol::UserCmd& cmd, const glm::vec3& target, NavTraversal traversal)
+{
+	// the edge was already probed while building the mesh, so no traces here
 
-	auto step_height = ground_next_pos.z - foot_next_pos.z;
+	const auto foot_origin = getFootOrigin();
+	const auto distance = glm::distance(glm::vec2{ foot_origin.x, foot_origin.y }, glm::vec2{ target.x, target.y });
 
-	if (step_height > StepHeight)
+	if (traversal == NavTraversal::Jump && distance <= PlayerWidth * 1.5f)
+	{
+		jump();
+		return MovementStatus::Processing;
+	}
+	else if (traversal == NavTraversal::CrouchJump && distance <= PlayerWidth * 1.5f)
 	{
 		jump(true);
 		return MovementStatus::Processing;
 	}
-	else if (glm::distance(ground_next_pos, roof_next_pos) < PlayerHeightStand)
+	else if (traversal == NavTraversal::DuckOnly && distance <= PlayerWidth * 2.0f)
 	{
 		duck();
 		return MovementStatus::Processing;
@@ -585,36 +912,121 @@ AiClient::MovementStatus AiClient::trivialAvoidVerticalObstacles(HL::Protocol::U
 	return MovementStatus::Finished;
 }
 
-AiClient::MovementStatus AiClient::navMoveTo(HL::Protocol::UserCmd& cmd, const glm::vec3& target)
+AiClient::MovementStatus AiClient::climbLadderTo(HL::Protocol::UserCmd& cmd, const glm::vec3& target)
+{
+	// we keep pushing into the ladder, the pitch decides whether we climb up or down
+
+	auto ladder = findNearestLadder(getOrigin());
+
+	if (ladder == nullptr)
+		return MovementStatus::Finished;
+
+	auto center = (ladder->mins + ladder->maxs) * 0.5f;
+
+	if (isOnLadder())
+		lookAt(cmd, glm::vec3{ center.x, center.y, target.z + PlayerOriginZStand });
+	else
+		lookAt(cmd, glm::vec3{ center.x, center.y, getOrigin().z });
+
+	moveTo(cmd, center);
+
+	return MovementStatus::Processing;
+}
+
+AiClient::MovementStatus AiClient::navMoveTo(HL::Protocol::UserCmd& cmd, const glm::vec3& target, bool shared_target)
 {
 	bool need_to_build_nav_chain = mNavChain.empty() || mNavChainTarget != target;
 
-	if (need_to_build_nav_chain)
+	// after getting stuck we wait for the penalty to reach the mesh, or we would plan the same way
+	if (!mStuckLinks.empty())
+		need_to_build_nav_chain = false;
+
+	// targets other bots may share go through the cached flow field, it is built once a second bot asks for it.
+	// this runs every tick until then, so both areas are looked up in their tiles only, off the mesh we plan as usual
+	if (need_to_build_nav_chain && shared_target && mUseFlowFields)
 	{
-		auto src_area = NavMesh::FindNearestArea(mNavMesh.explored_areas, getFootOrigin());
-		auto dst_area = NavMesh::FindNearestArea(mNavMesh.explored_areas, target);
-		mNavChain = buildNavChain(dst_area, src_area);
-		mNavChainTarget = target;
-		mNavChain.reverse();
+		auto src_area = mNavMesh->findExactArea(getFootOrigin(), getNavStep() * 1.25f);
+		auto dst_area = mNavMesh->findExactArea(target, getNavStep() * 1.25f);
+		auto chain = src_area != nullptr && dst_area != nullptr ? buildNavChainFromFlowField(mNavOwner, src_area, dst_area) : std::nullopt;
+
+		if (chain.has_value())
+		{
+			mNavChain = std::move(chain.value());
+			mNavChainTarget = target;
+			need_to_build_nav_chain = false;
+		}
 	}
 
+	// we keep following the old chain (or walk straight) until the new one is ready
+	if (need_to_build_nav_chain && !mThinkExecutor.isRunning(NavChainTaskName) && mNavChainScheduler.isDue(Clock::Now(), mNavChainRate))
+		mThinkExecutor.spawn(NavChainTaskName, planNavChain(target));
+
 	auto foot_origin = getFootOrigin();
 
 	while (!mNavChain.empty())
 	{
-		auto pos = mNavChain.front()->position;
-		auto distance_to_next_point = glm::distance(foot_origin, pos);
+		const auto& waypoint = mNavChain.back();
+		auto distance_to_next_point = glm::distance(foot_origin, waypoint.position);
 
 		if (distance_to_next_point >= PlayerWidth * 2.0f)
 			break;
 
-		mNavChain.pop_front();
+		bool is_climb = waypoint.traversal == NavTraversal::Jump || waypoint.traversal == NavTraversal::CrouchJump ||
+			waypoint.traversal == NavTraversal::Ladder;
+
+		if (is_climb && foot_origin.z < waypoint.position.z - StepHeight)
+			break; // still have to get up there
+
+		mNavChain.pop_back();
+	}
+
+	if (!mNavChain.empty() && isStuckOnNavChain(foot_origin))
+	{
+		mStuckLinks.push_back({ foot_origin, mNavChain.back().position });
+		mNavChain.clear();
 	}
 
 	if (mNavChain.empty())
 		return trivialMoveTo(cmd, target);
 	else
-		return trivialMoveTo(cmd, mNavChain.front()->position, false);
+		return trivialMoveTo(cmd, mNavChain.back().position, false, mNavChain.back().traversal);
+}
+
+bool AiClient::isStuckOnNavChain(const glm::vec3& foot_origin)
+{
+	const auto& waypoint = mNavChain.back().position;
+	auto distance = glm::distance(foot_origin, waypoint);
+	auto now = mWorld->time;
+
+	// a gap means we were busy with something else (avoiding, dead), so we start over
+	bool restart = !mWaypointProgress.has_value() || mWaypointProgress->waypoint != waypoint ||
+		now - mWaypointProgress->last_time > Clock::FromSeconds(StuckSeconds * 0.5f);
+
+	if (restart)
+	{
+		mWaypointProgress = WaypointProgress{ waypoint, distance, now, now };
+		return false;
+	}
+
+	mWaypointProgress->last_time = now;
+
+	if (distance < mWaypointProgress->best_distance - StuckProgressDistance)
+	{
+		mWaypointProgress->best_distance = distance;
+		mWaypointProgress->best_time = now;
+		return false;
+	}
+
+	auto stuck_time = now - mWaypointProgress->best_time;
+
+	if (stuck_time < Clock::FromSeconds(StuckSeconds))
+		return false;
+
+	mStuckMetric.add();
+	mStuckMillisecondsMetric.add((uint64_t)Clock::ToMilliseconds(stuck_time));
+	mWaypointProgress.reset();
+	HL::Utils::dlog("stuck on the way to {} {} {}", waypoint.x, waypoint.y, waypoint.z);
+	return true;
 }
 
 AiClient::MovementStatus AiClient::avoidOtherPlayers(HL::Protocol::UserCmd& cmd)
@@ -630,21 +1042,82 @@ AiClient::MovementStatus AiClient::avoidOtherPlayers(HL::Protocol::UserCmd& cmd)
 		return MovementStatus::Finished;
 
 	lookAt(cmd, *nearest_ent.value());
-	moveFrom(cmd, *nearest_ent.value());
+
+	// step to the calmest neighbouring area, so we do not back off into somebody else
+
+	const NavArea* calmest_area = nullptr;
+
+	if (auto current_area = mNavMesh->findExactArea(getFootOrigin(), getNavStep()); current_area != nullptr)
+	{
+		auto min_influence = mInfluence.get(current_area, mWorld->time);
+
+		for (auto dir : Directions)
+		{
+			auto link = current_area->getLink(dir);
+
+			if (link == nullptr)
+				continue;
+
+			auto influence = mInfluence.get(link->area, mWorld->time);
+
+			if (influence >= min_influence)
+				continue;
+
+			calmest_area = link->area;
+			min_influence = influence;
+		}
+	}
+
+	if (calmest_area != nullptr)
+		moveTo(cmd, calmest_area->position + glm::vec3{ 0.0f, 0.0f, getCurrentEyeHeight() });
+	else
+		moveFrom(cmd, *nearest_ent.value());
+
 	return MovementStatus::Processing;
 }
 
+void AiClient::setCustomMoveTarget(const std::optional<glm::vec3>& value, bool shared)
+{
+	std::lock_guard lock(mCustomMoveTargetMutex);
+	mCustomMoveTarget = value;
+	mCustomMoveTargetShared = shared;
+}
+
+std::optional<glm::vec3> AiClient::getCustomMoveTarget() const
+{
+	std::lock_guard lock(mCustomMoveTargetMutex);
+	return mCustomMoveTarget;
+}
+
+void AiClient::resetCustomMoveTarget(const glm::vec3& reached)
+{
+	// the user may have picked a new target while we were walking to the old one
+	std::lock_guard lock(mCustomMoveTargetMutex);
+
+	if (mCustomMoveTarget == reached)
+		mCustomMoveTarget.reset();
+}
+
 AiClient::MovementStatus AiClient::moveToCustomTarget(HL::Protocol::UserCmd& cmd)
 {
-	if (!mCustomMoveTarget.has_value())
+	std::optional<glm::vec3> custom_target;
+	bool shared_target = false;
+
+	{
+		std::lock_guard lock(mCustomMoveTargetMutex);
+		custom_target = mCustomMoveTarget;
+		shared_target = mCustomMoveTargetShared;
+	}
+
+	if (!custom_target.has_value())
 		return MovementStatus::Finished;
 
-	if (mNavMesh.explored_areas.empty())
+	if (mNavMesh->getExploredAreas().empty())
 		return MovementStatus::Processing;
 	
-	auto target = mCustomMoveTarget.value();
+	auto target = custom_target.value();
 	
-	auto target_ground = getGroundFromOrigin(mCustomMoveTarget.value());
+	auto target_ground = getGroundFromOrigin(custom_target.value());
 
 	if (target_ground.has_value())
 		target = target_ground.value();
@@ -652,7 +1125,7 @@ AiClient::MovementStatus AiClient::moveToCustomTarget(HL::Protocol::UserCmd& cmd
 	MovementStatus result;
 
 	if (mUseNavMovement)
-		result = navMoveTo(cmd, target);
+		result = navMoveTo(cmd, target, shared_target);
 	else
 		result = trivialMoveTo(cmd, target);
 
@@ -660,7 +1133,8 @@ AiClient::MovementStatus AiClient::moveToCustomTarget(HL::Protocol::UserCmd& cmd
 	{
 		if (getSpeed() == 0.0f)
 		{
-			mCustomMoveTarget.reset();
+			resetCustomMoveTarget(custom_target.value());
+			mNavMesh->releaseFrontier(mNavOwner);
 			return MovementStatus::Finished;
 		}
 	}
@@ -670,276 +1144,172 @@ AiClient::MovementStatus AiClient::moveToCustomTarget(HL::Protocol::UserCmd& cmd
 
 AiClient::MovementStatus AiClient::exploreNewAreas(HL::Protocol::UserCmd& cmd)
 {
-	if (mNavMesh.unexplored_areas.empty())
+	if (mNavMesh->getUnexploredAreas().empty())
 		return MovementStatus::Finished;
 
 	if (!mNavChain.empty())
 		return navMoveTo(cmd, mNavChainTarget);
 
-	auto area = NavMesh::FindNearestArea(mNavMesh.unexplored_areas, getFootOrigin());
-	auto pos = area->position;
-	setCustomMoveTarget(pos);
-	HL::Utils::dlog("exploring {} {} {}", pos.x, pos.y, pos.z);
+	// the search sets a custom move target when it is done, moveToCustomTarget takes it from there
+	if (!mThinkExecutor.isRunning(FrontierTaskName))
+		mThinkExecutor.spawn(FrontierTaskName, findFrontier());
+
 	return MovementStatus::Processing;
 }
 
-AiClient::BuildNavMeshStatus AiClient::buildNavMesh()
+ThinkTask AiClient::growNavMesh()
 {
-	bool all_explored_areas_collected = false;
-
-	while (!all_explored_areas_collected)
+	while (true)
 	{
-		all_explored_areas_collected = true;
-		for (auto area : mNavMesh.unexplored_areas)
+		while (!mNavMeshScheduler.isDue(Clock::Now(), mNavMeshRate))
+			co_await ThinkExecutor::nextTick();
+
+		// a round grows the mesh around us until nothing in reach is left to probe, a budget per tick
+		while (true)
 		{
-			if (!area->isExplored())
-				continue;
+			auto start = Clock::Now();
+			auto status = buildNavMesh();
+			mNavMeshTime += Clock::Now() - start;
 
-			mNavMesh.explored_areas.insert(area);
-			mNavMesh.unexplored_areas.erase(area);
-			all_explored_areas_collected = false;
-			break;
+			if (status == BuildNavMeshStatus::Finished)
+				break;
+
+			co_await ThinkExecutor::nextTick();
 		}
 	}
-
-	auto origin = getOrigin();
-	origin.x = origin.x - glm::mod(origin.x, NavStep);
-	origin.y = origin.y - glm::mod(origin.y, NavStep);
-
-	auto ground = getGroundFromOrigin(origin);
-
-	if (!ground.has_value())
-		return BuildNavMeshStatus::Processing;
-
-	return buildNavMesh(ground.value());
 }
 
-AiClient::BuildNavMeshStatus AiClient::buildNavMesh(const glm::vec3& start_ground_point)
+ThinkTask AiClient::planNavChain(glm::vec3 target)
 {
-	auto base_area = NavMesh::FindExactArea(mNavMesh.explored_areas, start_ground_point, mNavStep * 1.25f);
-
-	if (base_area == nullptr)
-		base_area = NavMesh::FindExactArea(mNavMesh.unexplored_areas, start_ground_point, mNavStep * 1.25f);
-
-	if (base_area == nullptr)
-	{
-		auto area = std::make_shared<NavArea>();
-		area->position = start_ground_point;
-		mNavMesh.unexplored_areas.insert(area);
-		return BuildNavMeshStatus::Processing;
-	}
-
-	std::list<std::shared_ptr<NavArea>> open_list;
-	std::unordered_set<std::shared_ptr<NavArea>> ignore;
-	open_list.push_back(base_area);
-	bool skip = false;
-
-	while (!open_list.empty())
-	{
-		auto area = open_list.back();
-		open_list.pop_back();
-
-		if (ignore.contains(area))
-			continue;
-
-		ignore.insert(area);
-
-		while (true)
-		{
-			if (buildNavMesh(area) != BuildNavMeshStatus::Finished)
-				skip = true;
-			else
-				break;
-		}
-
-		if (skip)
-			continue;
-
-		for (auto dir : Directions)
-		{
-			auto neighbour = area->neighbours.at(dir);
+	// a single search is not split, regions and tiles may change under it between ticks,
+	// but it waits for a tick that has budget left
+	co_await mThinkExecutor.checkpoint();
 
-			if (!neighbour.has_value())
-				continue;
+	std::shared_lock nav_lock(mNavMesh->getMutex());
 
-			auto neighbour_nn = neighbour.value().lock();
+	auto src_area = NavMesh::FindNearestArea(mNavMesh->getExploredAreas(), getFootOrigin());
+	auto dst_area = NavMesh::FindNearestArea(mNavMesh->getExploredAreas(), target);
 
-			if (getDistance(neighbour_nn->position) > mNavExploreDistance)
-				continue;
+	if (src_area == nullptr || dst_area == nullptr)
+		co_return; // the mesh was cleared while we waited
 
-			open_list.push_front(neighbour_nn);
-		}
-	}
+	mNavChain = buildNavChain(src_area, dst_area);
+	mNavChainTarget = target;
 
-	return skip ? BuildNavMeshStatus::Processing : BuildNavMeshStatus::Finished;
+	for (const auto& waypoint : mNavChain)
+		mNavMesh->prefetchTiles(waypoint.position, NavMesh::TileSize * 0.5f);
 }
 
-AiClient::BuildNavMeshStatus AiClient::buildNavMesh(std::shared_ptr<NavArea> base_area)
+ThinkTask AiClient::findFrontier()
 {
-	auto stepPosition = [&](const glm::vec3& pos, NavDirection dir) -> glm::vec3 {
-		auto dst_pos = pos;
-		if (dir == NavDirection::Back)
-			dst_pos.y -= mNavStep;
-		else if (dir == NavDirection::Forward)
-			dst_pos.y += mNavStep;
-		else if (dir == NavDirection::Left)
-			dst_pos.x += mNavStep;
-		else if (dir == NavDirection::Right)
-			dst_pos.x -= mNavStep;
-		return dst_pos;
-	};
-
-	for (auto dir : Directions)
-	{
-		if (base_area->neighbours.contains(dir))
-			continue;
-
-		auto src_pos = base_area->position;
-		src_pos.z += StepHeight;
-
-		auto dst_pos = stepPosition(src_pos, dir);
-		
-		if (!isVisible(src_pos, dst_pos))
-		{
-			base_area->neighbours.insert({ dir, std::nullopt });
-			return BuildNavMeshStatus::Processing;
-		}
-
-		auto dst_ground = getGroundFromOrigin(dst_pos).value();
+	// nearest unexplored area, preferably one we can walk to and no other bot is heading to.
+	// the scan may span ticks, the list can change in between, so we keep positions only and accept
+	// that a few candidates are seen twice or not at all
 
-		auto neighbour = NavMesh::FindExactArea(mNavMesh.explored_areas, dst_ground, 4.0f);
+	enum Preference { ReachableFree, Reachable, Any, PreferencesCount };
 
-		if (neighbour == nullptr)
-			neighbour = NavMesh::FindExactArea(mNavMesh.unexplored_areas, dst_ground, 4.0f);
+	std::array<std::optional<glm::vec3>, PreferencesCount> best;
+	std::array<float, PreferencesCount> best_distance;
+	best_distance.fill(MaxDistance);
 
-		auto opposite_dir = OppositeDirections.at(dir);
+	size_t index = 0;
 
-		if (neighbour != nullptr)
+	while (true)
+	{
 		{
-			base_area->neighbours.insert({ dir, neighbour });
-			neighbour->neighbours.insert({ opposite_dir, base_area });
-			return BuildNavMeshStatus::Processing;
-		}
+			std::shared_lock nav_lock(mNavMesh->getMutex());
 
-		auto area = std::make_shared<NavArea>();
-		area->position = dst_ground;
-		mNavMesh.unexplored_areas.insert(area);
+			const auto& candidates = mNavMesh->getUnexploredAreas();
+			auto foot_origin = getFootOrigin();
+			auto current_area = NavMesh::FindNearestArea(mNavMesh->getExploredAreas(), foot_origin);
+			auto slice_start = index; // every slice scans one batch at least, so we get through even on busy ticks
 
-		base_area->neighbours.insert({ dir, area });
-		area->neighbours.insert({ opposite_dir, base_area });
+			for (; index < candidates.size(); index++)
+			{
+				if (index != slice_start && index % FrontierScanBatch == 0 && mThinkExecutor.isOverBudget())
+					break;
 
-		return BuildNavMeshStatus::Processing;
-	}
+				auto candidate = candidates[index];
+				auto distance = glm::distance(foot_origin, candidate->position);
 
-	return BuildNavMeshStatus::Finished;
-}
+				if (distance >= best_distance[Any])
+					continue;
 
-NavChain AiClient::buildNavChain(std::shared_ptr<NavArea> src_area, std::shared_ptr<NavArea> dst_area)
-{
-	assert(src_area);
-	assert(dst_area);
+				best[Any] = candidate->position;
+				best_distance[Any] = distance;
 
-	struct Info
-	{
-		std::shared_ptr<NavArea> parent;
-		float cost_to_start = 0.0f; // g
-		float cost_to_finish = 0.0f; // h
-		auto get_cost_total() const { return cost_to_start + cost_to_finish; } // f
-		//auto get_cost_total() const { return cost_to_start; } // f, dijkstra
-	};
+				if (current_area != nullptr && !mNavMesh->isReachable(current_area, candidate))
+					continue;
 
-	std::unordered_map<std::shared_ptr<NavArea>, Info> infos;
-	std::unordered_set<std::shared_ptr<NavArea>> open_list;
-	std::unordered_set<std::shared_ptr<NavArea>> closed_list;
+				if (distance < best_distance[Reachable])
+				{
+					best[Reachable] = candidate->position;
+					best_distance[Reachable] = distance;
+				}
 
-	auto find_best_from_open_list = [&] {
-		float min_cost = std::numeric_limits<float>::max();
-		std::shared_ptr<NavArea> result = nullptr;
-		for (auto area : open_list)
-		{
-			const auto& info = infos.at(area);
-			auto cost_total = info.get_cost_total();
-			if (cost_total < min_cost)
-			{
-				result = area;
-				min_cost = cost_total;
+				if (distance >= best_distance[ReachableFree] || mNavMesh->isFrontierReserved(mNavOwner, candidate->position))
+					continue;
+
+				best[ReachableFree] = candidate->position;
+				best_distance[ReachableFree] = distance;
 			}
-		}
-		assert(result);
-		return result;
-	};
 
-	auto assemble_chain = [&](std::shared_ptr<NavArea> a) {
-		auto result = NavChain{};
-		while (a != nullptr)
-		{
-			result.push_front(a);
-			a = infos.at(a).parent;
+			if (index >= candidates.size())
+				break;
 		}
-		return result;
-	};
 
-	auto get_cost_multiplier = [](std::shared_ptr<NavArea> a) {
-		const float total_penalty = 16.0f;
-		float result = total_penalty;
-		for (auto dir : Directions)
-		{
-			if (!a->neighbours.contains(dir))
-				continue;//return -1.0f; // promote researching
+		co_await mThinkExecutor.checkpoint();
+	}
 
-			auto neighbour = a->neighbours.at(dir);
+	if (!best[Any].has_value())
+		co_return;
 
-			if (!neighbour.has_value())
-				continue;
+	auto pos = best[ReachableFree].value_or(best[Reachable].value_or(best[Any].value()));
+	mNavMesh->reserveFrontier(mNavOwner, pos, mNavExploreDistance, Clock::FromSeconds(FrontierReservationSeconds));
+	setCustomMoveTarget(pos, false); // reserved for us, no other bot walks there
+	HL::Utils::dlog("exploring {} {} {}", pos.x, pos.y, pos.z);
+}
 
-			result -= total_penalty / static_cast<float>(Directions.size());
-		}
-		return result + 1.0f;
-	};
+AiClient::BuildNavMeshStatus AiClient::buildNavMesh()
+{
+	std::unique_lock nav_lock(mNavMesh->getMutex());
 
-	auto& src_area_info = infos[src_area];
-	src_area_info.cost_to_finish = glm::distance(src_area->position, dst_area->position);
-	open_list.insert(src_area);
+	// keep the tiles around us and along our route resident, everything else may be paged out
 
-	while (!open_list.empty())
-	{
-		auto area = find_best_from_open_list();
+	mNavMesh->integratePrefetchedTiles();
+	mNavMesh->requireTiles(getOrigin(), mNavExploreDistance + getNavStep());
 
-		if (area == dst_area)
-			return assemble_chain(area);
+	for (const auto& waypoint : mNavChain)
+		mNavMesh->requireTiles(waypoint.position, 0.0f);
 
-		open_list.erase(area);
-		closed_list.insert(area);
+	for (const auto& [from, towards] : mStuckLinks)
+		penalizeNavLink(from, towards);
 
-		for (auto [dir, neighbour] : area->neighbours)
-		{
-			if (!neighbour.has_value())
-				continue;
+	mStuckLinks.clear();
+
+	mNavMesh->evictTiles((size_t)std::max(mNavTileBudget, 0) * 1024, Clock::FromSeconds(NavTileMinIdleSeconds));
+	mNavMesh->collectExploredAreas();
 
-			auto neighbour_nn = neighbour->lock();
+	auto origin = getOrigin();
+	origin.x = origin.x - glm::mod(origin.x, getNavStep());
+	origin.y = origin.y - glm::mod(origin.y, getNavStep());
 
-			if (!neighbour_nn->neighbours.at(OppositeDirections.at(dir)).has_value())
-				continue; // do not allow one-way connections, because we swap src and dst areas
+	auto ground = getGroundFromOrigin(origin, getCurrentHull());
 
-			if (closed_list.contains(neighbour_nn))
-				continue;
+	if (!ground.has_value())
+		return BuildNavMeshStatus::Finished; // nothing to grow from until we land
 
-			auto cost_multiplier = get_cost_multiplier(neighbour_nn);
-			auto cost_to_start = infos.at(area).cost_to_start + glm::distance(area->position, neighbour_nn->position) * cost_multiplier;
+	auto status = buildNavMesh(ground.value(), getOrigin(), mThinkExecutor.getDeadline());
 
-			bool neighbour_is_better = !infos.contains(neighbour_nn) || infos.at(neighbour_nn).cost_to_start > cost_to_start;
-			
-			if (!neighbour_is_better)
-				continue;
+	// the visibility table catches up with the mesh a few pairs per tick
+	updateNavVisibility(NavVisibilityTracesPerTick);
 
-			open_list.insert(neighbour_nn);
+	// and the regions a few tiles per tick
+	mNavMesh->updateRegions(NavRegionTilesPerTick);
 
-			auto& info = infos[neighbour_nn];
-			info.parent = area;
-			info.cost_to_finish = glm::distance(neighbour_nn->position, dst_area->position);
-			info.cost_to_start = cost_to_start;
-		}
-	}
+	// then the flow fields bots asked for
+	if (mUseFlowFields)
+		updateFlowFields(FlowFieldBuildsPerTick);
 
-	return { };
+	return status;
 }
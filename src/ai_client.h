@@ -1,73 +1,48 @@
 #pragma once
 
 #include <HL/playable_client.h>
-#include <HL/bspfile.h>
-
-enum class NavDirection
-{
-	Forward,
-	Back,
-	Left,
-	Right
-};
-
-struct NavArea
-{
-	glm::vec3 position = { 0.0f, 0.0f, 0.0f };
-	std::map<NavDirection, std::optional<std::weak_ptr<NavArea>>> neighbours;
-	bool isExplored() const;
-	bool isBorder() const;
-	bool isNeighbour(std::shared_ptr<NavArea> area) const;
-};
-
-struct NavMesh
-{
-	using AreaSet = std::unordered_set<std::shared_ptr<NavArea>>;
-
-	AreaSet explored_areas;
-	AreaSet unexplored_areas;
-
-	static std::shared_ptr<NavArea> FindNearestArea(const AreaSet& areas, const glm::vec3& pos);
-	static std::shared_ptr<NavArea> FindExactArea(const AreaSet& areas, const glm::vec3& pos, float tolerance);
-};
-
-using NavChain = std::list<std::shared_ptr<NavArea>>;
-
-const std::vector<NavDirection> Directions = {
-	NavDirection::Forward,
-	NavDirection::Left,
-	NavDirection::Right,
-	NavDirection::Back,
-};
-
-const std::map<NavDirection, NavDirection> OppositeDirections = {
-	{ NavDirection::Forward, NavDirection::Back },
-	{ NavDirection::Back, NavDirection::Forward },
-	{ NavDirection::Left, NavDirection::Right },
-	{ NavDirection::Right, NavDirection::Left },
-};
-
-class AiClient : public HL::PlayableClient
+#include "think_scheduler.h"
+#include "think_task.h"
+#include "navigator.h"
+#include "world_snapshot.h"
+#include "triple_buffer.h"
+#include "spsc_queue.h"
+#include "map_store.h"
+#include "map_prewarm.h"
+#include "flight_recorder.h"
+#include "nav_stream.h"
+#include "metrics.h"
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+class AiClient : public HL::PlayableClient, public Navigator
 {
 private:
-	const float PlayerHeightStand = 72.0f;
-	const float PlayerHeightDuck = 36.0f;
-	const float PlayerOriginZStand = 36.0f;
-	const float PlayerOriginZDuck = 18.0f;
-	const float PlayerWidth = 32.0f;
-	const float StepHeight = 18.0f; // if delta Z is greater than this, we have to jump to get up (MoveVars.stepsize)
-	const float JumpHeight = 41.8f; // if delta Z is less than this, we can jump up on it
-	const float JumpCrouchHeight = 58.0f; // (48) if delta Z is less than or equal to this, we can jumpcrouch up on it
-	const float MaxDistance = 8192.0f;
 	const float WalkSpeedMultiplier = 0.4f;
 	const float UseRadius = 64.0f;
 	const float JumpCooldownSeconds = 1.0f; // we should not bunnyhopping, because next jumps are not high
 
-	const float NavStep = PlayerWidth * 1.0f;
-	const float NavExploreDistance = 256.0f;
-
 	const float TrivialMovementMinDistance = PlayerWidth * 0.75f;
 
+	const float ThinkRate = 30.0f;
+	const float NavMeshRate = 10.0f;
+	const float NavChainRate = 5.0f;
+	const float FrontierReservationSeconds = 10.0f;
+	const float NavTileMinIdleSeconds = 5.0f;
+	const float FlightDumpSeconds = 30.0f;
+	const float NavStreamRate = 10.0f; // batches sent to nav viewers per second
+	const size_t NavVisibilityTracesPerTick = 64;
+	const size_t NavRegionTilesPerTick = 2;
+	const size_t FlowFieldBuildsPerTick = 1;
+	const float StuckSeconds = 2.0f; // without getting closer to the next waypoint
+	const float TaskBudgetMilliseconds = 4.0f; // of think tasks per tick, a task may overrun it by one step
+	const size_t FrontierScanBatch = 64; // candidates between budget checks
+	inline static const std::string NavMeshTaskName = "nav mesh";
+	inline static const std::string NavChainTaskName = "nav chain";
+	inline static const std::string FrontierTaskName = "frontier";
+	const float StuckProgressDistance = 8.0f;
+
 public:
 	AiClient();
 	~AiClient();
@@ -84,13 +59,19 @@ private:
 	void initializeGame() override;
 	void resetGameResources() override;
 	void think(HL::Protocol::UserCmd& cmd);
+	void captureWorld(Clock::TimePoint now, Clock::Duration delta);
+	void captureEntities(EntitySnapshot& entities);
+	void thinkTick(const WorldSnapshot& world);
+	void recordThinkTick(const HL::Protocol::UserCmd& cmd, Clock::TimePoint tick_start, Clock::TimePoint movement_start, Clock::TimePoint movement_end);
+	void streamThinkTick();
+	void startThinkThread();
+	void stopThinkThread();
 	void synchronizeBspModel();
 	void movement(HL::Protocol::UserCmd& cmd);
+	void updateInfluence();
 	glm::vec3 getFootOrigin() const;
-	std::optional<glm::vec3> getGroundFromOrigin(const glm::vec3& origin) const;
-	std::optional<glm::vec3> getRoofFromOrigin(const glm::vec3& origin) const;
-	std::optional<HL::Protocol::Entity*> findNearestVisiblePlayerEntity();
-	bool isVisible(const glm::vec3& eye, const glm::vec3& target) const;
+	std::optional<const HL::Protocol::Entity*> findNearestVisiblePlayerEntity();
+	using Navigator::isVisible;
 	bool isVisible(const glm::vec3& target) const;
 	bool isVisible(const HL::Protocol::Entity& entity) const;
 	bool isAlive() const;
@@ -102,6 +83,7 @@ private:
 	float getHealth() const;
 	float getCurrentHeight() const;
 	float getCurrentEyeHeight() const;
+	BspHull getCurrentHull() const;
 	float getSpeed() const;
 	float getDistance(const glm::vec3& target) const;
 	float getDistance(const HL::Protocol::Entity& entity) const;
@@ -114,16 +96,6 @@ private:
 	void jump(bool duck = false);
 	void duck();
 
-public:
-	struct TraceResult
-	{
-		glm::vec3 endpos = { 0.0f, 0.0f, 0.0f };
-		float fraction = 0.0f;
-		bool start_solid = false;
-	};
-
-	TraceResult traceLine(const glm::vec3& begin, const glm::vec3& end) const;
-
 private:
 	enum class MovementStatus
 	{
@@ -131,49 +103,111 @@ private:
 		Processing
 	};
 
-	MovementStatus trivialMoveTo(HL::Protocol::UserCmd& cmd, const glm::vec3& target, bool allow_walk = true);
+	MovementStatus trivialMoveTo(HL::Protocol::UserCmd& cmd, const glm::vec3& target, bool allow_walk = true, std::optional<NavTraversal> traversal = std::nullopt);
 	MovementStatus trivialAvoidWallCorners(HL::Protocol::UserCmd& cmd, const glm::vec3& target);
 	MovementStatus trivialAvoidVerticalObstacles(HL::Protocol::UserCmd& cmd, const glm::vec3& target);
-	MovementStatus navMoveTo(HL::Protocol::UserCmd& cmd, const glm::vec3& target);
+	MovementStatus followNavTraversal(HL::Protocol::UserCmd& cmd, const glm::vec3& target, NavTraversal traversal);
+	MovementStatus climbLadderTo(HL::Protocol::UserCmd& cmd, const glm::vec3& target);
+	MovementStatus navMoveTo(HL::Protocol::UserCmd& cmd, const glm::vec3& target, bool shared_target = false);
+	bool isStuckOnNavChain(const glm::vec3& foot_origin);
 	MovementStatus avoidOtherPlayers(HL::Protocol::UserCmd& cmd);
 	MovementStatus moveToCustomTarget(HL::Protocol::UserCmd& cmd);
+	void resetCustomMoveTarget(const glm::vec3& reached);
 	MovementStatus exploreNewAreas(HL::Protocol::UserCmd& cmd);
+
+private:
+	ThinkTask growNavMesh();
+	ThinkTask planNavChain(glm::vec3 target);
+	ThinkTask findFrontier();
 	
 private:
-	enum class BuildNavMeshStatus
-	{
-		Finished,
-		Processing
-	};
-
+	using Navigator::buildNavMesh;
 	BuildNavMeshStatus buildNavMesh();
-	BuildNavMeshStatus buildNavMesh(const glm::vec3& start_ground_point);
-	BuildNavMeshStatus buildNavMesh(std::shared_ptr<NavArea> base_area);
-	NavChain buildNavChain(std::shared_ptr<NavArea> src_area, std::shared_ptr<NavArea> dst_area);
 
 public:
-	void setCustomMoveTarget(const glm::vec3& value) { mCustomMoveTarget = value; };
-	const auto& getCustomMoveTarget() const { return mCustomMoveTarget; }
-	const auto& getBsp() const { return mBspFile; }
-	const auto& getNavMesh() const { return mNavMesh; }
+	void setCustomMoveTarget(const std::optional<glm::vec3>& value, bool shared = true); // shared targets may be walked to by other bots as well
+	std::optional<glm::vec3> getCustomMoveTarget() const;
+
+	// held while the think logic runs, so debug views can read the mesh and the chain from the render thread
+	auto& getThinkMutex() const { return mThinkMutex; }
 	const auto& getNavChain() const { return mNavChain; }
 
-	auto getUseNavMovement() const { return mUseNavMovement; }
+	bool getUseNavMovement() const { return mUseNavMovement; }
 	void setUseNavMovement(bool value) { mUseNavMovement = value; }
 
 private:
 	Clock::TimePoint mThinkTime = Clock::Now();
-	BSPFile mBspFile;
 	glm::vec3 mPrevViewAngles = { 0.0f, 0.0f, 0.0f };
 	std::optional<glm::vec3> mCustomMoveTarget;
+	bool mCustomMoveTargetShared = true; // false for our exploration frontier
 	bool mWantJump = false;
 	bool mWantDuck = false;
 	Clock::TimePoint mLastAirTime = Clock::Now();
-	NavMesh mNavMesh;
 	NavChain mNavChain;
 	glm::vec3 mNavChainTarget;
-	bool mUseNavMovement = true;
-	float mNavExploreDistance = NavExploreDistance;
-	float mNavStep = NavStep;
-	std::set<int> mBspModelIndices;
+	std::atomic<bool> mUseNavMovement = true; // toggled by the gameplay screen
+	bool mUseFlowFields = true;
+	ThinkScheduler mThinkScheduler; // network thread, decides when a snapshot is captured
+	ThinkScheduler mNavMeshScheduler;
+	ThinkScheduler mNavChainScheduler;
+	float mThinkRate = ThinkRate;
+	float mNavMeshRate = NavMeshRate;
+	float mNavChainRate = NavChainRate;
+	float mTaskBudgetMilliseconds = TaskBudgetMilliseconds;
+	ThinkExecutor mThinkExecutor; // used by the think logic only
+	HL::Protocol::UserCmd mThinkCmd = {};
+	int mNavTileBudget = 0; // kilobytes of resident nav tiles, 0 is unlimited
+	TripleBuffer<WorldSnapshot> mWorldBuffer; // network thread -> think logic
+	SpscQueue<HL::Protocol::UserCmd, 8> mThinkCmds; // think logic -> network thread
+	const WorldSnapshot* mWorld = nullptr; // valid only inside thinkTick
+	std::atomic<uint32_t> mWorldSerial = 0;
+	std::atomic<bool> mNavClearPending = false;
+	uint32_t mNavGeneration = 0; // of the mesh our chain and influence were made on
+	mutable std::mutex mThinkMutex;
+	mutable std::mutex mCustomMoveTargetMutex;
+	std::thread mThinkThread;
+	std::atomic<bool> mThinkThreadRunning = false;
+	bool mUseThinkThread = false;
+	SharedNavMesh::OwnerId mNavOwner = SharedNavMesh::MakeOwnerId();
+	std::optional<MapStore::Hash> mMapHash; // announced by the server, consumed by initializeGame
+	std::optional<std::filesystem::path> mStoredMapPath;
+	bool mMapFromStore = false;
+	FlightRecorder mFlightRecorder;
+	NavStream mNavStream; // off until nav_stream_port is set, used under the think mutex
+	ThinkScheduler mNavStreamScheduler;
+	FlightRecordFormat::Branch mMovementBranch = FlightRecordFormat::Branch::None;
+	Clock::Duration mNavMeshTime = Clock::Duration::zero();
+
+	struct WaypointProgress
+	{
+		glm::vec3 waypoint = { 0.0f, 0.0f, 0.0f };
+		float best_distance = 0.0f;
+		Clock::TimePoint best_time;
+		Clock::TimePoint last_time;
+	};
+
+	std::optional<WaypointProgress> mWaypointProgress;
+	std::vector<std::pair<glm::vec3, glm::vec3>> mStuckLinks; // from, towards, penalized under the unique nav lock
+
+	// see Metrics, gauges and the stuck counters are per bot, they are shown in the stats and streamed.
+	// other counters and histograms are summed over the bots of this process
+	bool mShowStats = true;
+	std::string mMetricsLabels = "bot=\"" + std::to_string(mNavOwner) + "\"";
+	Metrics::Counter& mThinkTicksMetric = Metrics::GetCounter("xclient_think_ticks_total", "Think ticks run.");
+	Metrics::Counter& mTracesMetric = Metrics::GetCounter("xclient_traces_total", "Traces made by the think logic.");
+	Metrics::Counter& mExpansionsMetric = Metrics::GetCounter("xclient_nav_expansions_total", "Nodes expanded by the nav planners.");
+	Metrics::Counter& mStuckMetric = Metrics::GetCounter("xclient_stuck_total", "Times a bot got stuck on its nav chain.", mMetricsLabels);
+	Metrics::Counter& mStuckMillisecondsMetric = Metrics::GetCounter("xclient_stuck_milliseconds_total", "Time spent stuck before giving up on a waypoint.", mMetricsLabels);
+	Metrics::Histogram& mThinkTimeMetric = Metrics::GetHistogram("xclient_think_seconds", "Think tick duration.");
+	Metrics::Histogram& mNavMeshTimeMetric = Metrics::GetHistogram("xclient_nav_mesh_seconds", "Nav mesh building time of a think tick.");
+	Metrics::Histogram& mMovementTimeMetric = Metrics::GetHistogram("xclient_movement_seconds", "Movement and planning time of a think tick, without nav mesh building.");
+	Metrics::Gauge& mExploredAreasMetric = Metrics::GetGauge("xclient_nav_explored_areas", "Explored areas of the nav mesh.", mMetricsLabels);
+	Metrics::Gauge& mUnexploredAreasMetric = Metrics::GetGauge("xclient_nav_unexplored_areas", "Areas of the nav mesh waiting to be explored.", mMetricsLabels);
+	Metrics::Gauge& mResidentTilesMetric = Metrics::GetGauge("xclient_nav_resident_tiles", "Nav mesh tiles in memory.", mMetricsLabels);
+	Metrics::Gauge& mPagedTilesMetric = Metrics::GetGauge("xclient_nav_paged_tiles", "Nav mesh tiles paged out.", mMetricsLabels);
+	Metrics::Gauge& mNavRegionsMetric = Metrics::GetGauge("xclient_nav_regions", "Nav mesh regions.", mMetricsLabels);
+	Metrics::Gauge& mFlowFieldsMetric = Metrics::GetGauge("xclient_nav_flow_fields", "Cached flow fields.", mMetricsLabels);
+	Metrics::Gauge& mVisibilityClustersMetric = Metrics::GetGauge("xclient_nav_visibility_clusters", "Clusters of the nav visibility table.", mMetricsLabels);
+	Metrics::Gauge& mVisibilityPendingMetric = Metrics::GetGauge("xclient_nav_visibility_pending", "Cluster pairs waiting for a visibility trace.", mMetricsLabels);
+	Metrics::Gauge& mThinkAllocationsMetric = Metrics::GetGauge("xclient_think_allocations", "Heap allocations of the last think tick, with BUILD_ALLOCATION_STATS.", mMetricsLabels);
 };
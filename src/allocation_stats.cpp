@@ -0,0 +1,60 @@
+#include "allocation_stats.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(BUILD_ALLOCATION_STATS)
+static std::atomic<uint64_t> gAllocationCount = 0;
+static thread_local uint64_t gThreadAllocationCount = 0;
+
+void* operator new(std::size_t size)
+{
+	gAllocationCount.fetch_add(1, std::memory_order_relaxed);
+	gThreadAllocationCount += 1;
+
+	if (size == 0)
+		size = 1;
+
+	if (auto ptr = std::malloc(size))
+		return ptr;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t size) noexcept
+{
+	std::free(ptr);
+}
+#endif
+
+bool AllocationStats::IsEnabled()
+{
+#if defined(BUILD_ALLOCATION_STATS)
+	return true;
+#else
+	return false;
+#endif
+}
+
+uint64_t AllocationStats::GetCount()
+{
+#if defined(BUILD_ALLOCATION_STATS)
+	return gAllocationCount.load(std::memory_order_relaxed);
+#else
+	return 0;
+#endif
+}
+
+uint64_t AllocationStats::GetThreadCount()
+{
+#if defined(BUILD_ALLOCATION_STATS)
+	return gThreadAllocationCount;
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+// process-wide operator new counter, compiled in with -DBUILD_ALLOCATION_STATS=ON
+
+namespace AllocationStats
+{
+	bool IsEnabled();
+	uint64_t GetCount();
+	uint64_t GetThreadCount(); // only allocations made by the calling thread
+}
@@ -0,0 +1,350 @@
+#include "bsp_hulls.h"
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+namespace
+{
+	// goldsrc bsp v30 on disk layout
+
+	constexpr int BspVersion = 30;
+	constexpr int LumpEntities = 0;
+	constexpr int LumpPlanes = 1;
+	constexpr int LumpClipNodes = 9;
+	constexpr int LumpModels = 14;
+	constexpr int LumpsCount = 15;
+
+	constexpr int ContentsEmpty = -1;
+	constexpr int ContentsSolid = -2;
+
+	constexpr float DistEpsilon = 0.03125f;
+
+	struct Lump
+	{
+		int32_t offset;
+		int32_t length;
+	};
+
+	struct Header
+	{
+		int32_t version;
+		Lump lumps[LumpsCount];
+	};
+
+	struct DiskPlane
+	{
+		float normal[3];
+		float dist;
+		int32_t type;
+	};
+
+	struct DiskClipNode
+	{
+		int32_t plane;
+		int16_t children[2];
+	};
+
+	struct DiskModel
+	{
+		float mins[3];
+		float maxs[3];
+		float origin[3];
+		int32_t head_nodes[4];
+		int32_t vis_leafs;
+		int32_t first_face;
+		int32_t faces_count;
+	};
+
+	template <typename T> bool ReadLump(const std::vector<char>& data, const Lump& lump, std::vector<T>& result)
+	{
+		if (lump.offset < 0 || lump.length < 0 || (size_t)lump.offset + (size_t)lump.length > data.size())
+			return false;
+
+		if (lump.length % sizeof(T) != 0)
+			return false;
+
+		result.resize(lump.length / sizeof(T));
+		std::memcpy(result.data(), data.data() + lump.offset, lump.length);
+		return true;
+	}
+}
+
+bool BspHulls::load(const std::string& path)
+{
+	clear();
+
+	std::ifstream file(path, std::ios::binary);
+
+	if (!file)
+		return false;
+
+	std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	if (data.size() < sizeof(Header))
+		return false;
+
+	Header header;
+	std::memcpy(&header, data.data(), sizeof(header));
+
+	if (header.version != BspVersion)
+		return false;
+
+	std::vector<DiskPlane> planes;
+	std::vector<DiskClipNode> clip_nodes;
+	std::vector<DiskModel> models;
+
+	if (!ReadLump(data, header.lumps[LumpPlanes], planes) ||
+		!ReadLump(data, header.lumps[LumpClipNodes], clip_nodes) ||
+		!ReadLump(data, header.lumps[LumpModels], models))
+		return false;
+
+	for (const auto& plane : planes)
+	{
+		mPlanes.push_back({ { plane.normal[0], plane.normal[1], plane.normal[2] }, plane.dist, plane.type });
+	}
+
+	for (const auto& clip_node : clip_nodes)
+	{
+		if (clip_node.plane < 0 || clip_node.plane >= (int)mPlanes.size())
+		{
+			clear();
+			return false;
+		}
+
+		mClipNodes.push_back({ clip_node.plane, { clip_node.children[0], clip_node.children[1] } });
+	}
+
+	for (const auto& model : models)
+	{
+		Model result;
+		result.mins = { model.mins[0], model.mins[1], model.mins[2] };
+		result.maxs = { model.maxs[0], model.maxs[1], model.maxs[2] };
+		std::copy(std::begin(model.head_nodes), std::end(model.head_nodes), std::begin(result.head_nodes));
+		mModels.push_back(result);
+	}
+
+	std::vector<char> entities;
+
+	if (ReadLump(data, header.lumps[LumpEntities], entities))
+		loadLadders(std::string(entities.begin(), entities.end()));
+
+	return true;
+}
+
+void BspHulls::loadLadders(const std::string& entities)
+{
+	// { "key" "value" ... } blocks, we only need the brush model and the origin of every func_ladder
+
+	std::unordered_map<std::string, std::string> entity;
+	std::string key;
+	bool has_key = false;
+	size_t pos = 0;
+
+	while (pos < entities.size())
+	{
+		auto c = entities[pos];
+
+		if (c == '{')
+		{
+			entity.clear();
+			has_key = false;
+			pos += 1;
+		}
+		else if (c == '"')
+		{
+			auto end = entities.find('"', pos + 1);
+
+			if (end == std::string::npos)
+				break;
+
+			auto token = entities.substr(pos + 1, end - pos - 1);
+			pos = end + 1;
+
+			if (has_key)
+				entity[key] = token;
+			else
+				key = token;
+
+			has_key = !has_key;
+		}
+		else if (c == '}')
+		{
+			pos += 1;
+
+			if (entity["classname"] != "func_ladder" || !entity["model"].starts_with("*"))
+				continue;
+
+			auto model_index = std::atoi(entity["model"].c_str() + 1);
+
+			if (model_index <= 0 || model_index >= (int)mModels.size())
+				continue;
+
+			glm::vec3 origin = { 0.0f, 0.0f, 0.0f };
+			std::sscanf(entity["origin"].c_str(), "%f %f %f", &origin.x, &origin.y, &origin.z);
+
+			const auto& model = mModels.at(model_index);
+			mLadders.push_back({ model.mins + origin, model.maxs + origin });
+		}
+		else
+		{
+			pos += 1;
+		}
+	}
+}
+
+void BspHulls::clear()
+{
+	mPlanes.clear();
+	mClipNodes.clear();
+	mModels.clear();
+	mModelOrigins.clear();
+	mLadders.clear();
+}
+
+void BspHulls::setModelOrigin(int model_index, const glm::vec3& origin)
+{
+	mModelOrigins[model_index] = origin;
+}
+
+BspHulls::TraceResult BspHulls::trace(const glm::vec3& begin, const glm::vec3& end, BspHull hull, const std::set<int>& model_indices) const
+{
+	if (!isLoaded())
+		return {};
+
+	auto result = traceModel(mModels.front(), begin, end, hull);
+
+	for (auto model_index : model_indices)
+	{
+		if (model_index <= 0 || model_index >= (int)mModels.size())
+			continue;
+
+		// brush models only move, so we trace in their space
+		auto origin = glm::vec3{ 0.0f, 0.0f, 0.0f };
+
+		if (auto it = mModelOrigins.find(model_index); it != mModelOrigins.end())
+			origin = it->second;
+
+		auto model_result = traceModel(mModels.at(model_index), begin - origin, end - origin, hull);
+		model_result.endpos += origin;
+
+		if (model_result.all_solid || model_result.start_solid || model_result.fraction < result.fraction)
+		{
+			model_result.start_solid = model_result.start_solid || result.start_solid;
+			result = model_result;
+		}
+		else if (model_result.start_solid)
+		{
+			result.start_solid = true;
+		}
+	}
+
+	return result;
+}
+
+BspHulls::TraceResult BspHulls::traceModel(const Model& model, const glm::vec3& begin, const glm::vec3& end, BspHull hull) const
+{
+	TraceResult result;
+	result.fraction = 1.0f;
+	result.all_solid = true;
+	result.endpos = end;
+
+	auto head_node = model.head_nodes[static_cast<int>(hull)];
+	recursiveHullCheck(head_node, head_node, 0.0f, 1.0f, begin, end, result);
+
+	if (result.all_solid)
+		result.start_solid = true;
+
+	if (result.fraction >= 1.0f)
+		result.endpos = end;
+
+	return result;
+}
+
+bool BspHulls::recursiveHullCheck(int head_node, int node, float p1f, float p2f, const glm::vec3& p1, const glm::vec3& p2, TraceResult& trace) const
+{
+	// port of the quake SV_RecursiveHullCheck, returns false when the trace was stopped
+
+	if (node < 0)
+	{
+		if (node != ContentsSolid)
+			trace.all_solid = false;
+		else
+			trace.start_solid = true;
+
+		return true;
+	}
+
+	const auto& clip_node = mClipNodes.at(node);
+	const auto& plane = mPlanes[clip_node.plane];
+
+	auto t1 = getPlaneDistance(plane, p1);
+	auto t2 = getPlaneDistance(plane, p2);
+
+	if (t1 >= 0.0f && t2 >= 0.0f)
+		return recursiveHullCheck(head_node, clip_node.children[0], p1f, p2f, p1, p2, trace);
+
+	if (t1 < 0.0f && t2 < 0.0f)
+		return recursiveHullCheck(head_node, clip_node.children[1], p1f, p2f, p1, p2, trace);
+
+	// put the crosspoint DistEpsilon pixels on the near side
+	auto frac = t1 < 0.0f ? (t1 + DistEpsilon) / (t1 - t2) : (t1 - DistEpsilon) / (t1 - t2);
+	frac = glm::clamp(frac, 0.0f, 1.0f);
+
+	auto midf = p1f + (p2f - p1f) * frac;
+	auto mid = p1 + (p2 - p1) * frac;
+	int side = t1 < 0.0f ? 1 : 0;
+
+	if (!recursiveHullCheck(head_node, clip_node.children[side], p1f, midf, p1, mid, trace))
+		return false;
+
+	if (getPointContents(clip_node.children[side ^ 1], mid) != ContentsSolid)
+		return recursiveHullCheck(head_node, clip_node.children[side ^ 1], midf, p2f, mid, p2, trace);
+
+	if (trace.all_solid)
+		return false; // never got out of the solid area
+
+	// the other side of the node is solid, this is the impact point
+
+	trace.plane_normal = side == 0 ? plane.normal : -plane.normal;
+
+	while (getPointContents(head_node, mid) == ContentsSolid)
+	{
+		// shouldn't really happen, but does occasionally
+		frac -= 0.1f;
+
+		if (frac < 0.0f)
+		{
+			trace.fraction = midf;
+			trace.endpos = mid;
+			return false;
+		}
+
+		midf = p1f + (p2f - p1f) * frac;
+		mid = p1 + (p2 - p1) * frac;
+	}
+
+	trace.fraction = midf;
+	trace.endpos = mid;
+	return false;
+}
+
+int BspHulls::getPointContents(int node, const glm::vec3& point) const
+{
+	while (node >= 0)
+	{
+		const auto& clip_node = mClipNodes.at(node);
+		node = clip_node.children[getPlaneDistance(mPlanes[clip_node.plane], point) < 0.0f ? 1 : 0];
+	}
+
+	return node;
+}
+
+float BspHulls::getPlaneDistance(const Plane& plane, const glm::vec3& point) const
+{
+	// axial planes skip the dot product
+	if (plane.type < 3)
+		return point[plane.type] - plane.dist;
+
+	return glm::dot(plane.normal, point) - plane.dist;
+}
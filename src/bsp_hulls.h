@@ -0,0 +1,84 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <set>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// swept box traces against the clip hulls the bsp compiler already expanded by the player sizes,
+// so a box trace is as cheap as a ray trace through the clipnode tree.
+// positions are hull centers (player origins), not feet.
+// also keeps the boxes of func_ladder entities, ladders are not solid so traces never see them
+
+enum class BspHull
+{
+	Point = 0, // not stored in the clipnodes, see Navigator::traceHull
+	Stand = 1, // 32x32x72
+	Large = 2, // 64x64x64
+	Duck = 3 // 32x32x36
+};
+
+class BspHulls
+{
+public:
+	struct TraceResult
+	{
+		glm::vec3 endpos = { 0.0f, 0.0f, 0.0f };
+		float fraction = 1.0f;
+		bool start_solid = false;
+		bool all_solid = false;
+		glm::vec3 plane_normal = { 0.0f, 0.0f, 0.0f };
+	};
+
+	struct Ladder
+	{
+		glm::vec3 mins;
+		glm::vec3 maxs;
+	};
+
+public:
+	bool load(const std::string& path);
+	void clear();
+	bool isLoaded() const { return !mModels.empty(); }
+
+	void setModelOrigin(int model_index, const glm::vec3& origin);
+	TraceResult trace(const glm::vec3& begin, const glm::vec3& end, BspHull hull, const std::set<int>& model_indices) const;
+
+	const auto& getLadders() const { return mLadders; }
+
+private:
+	struct Plane
+	{
+		glm::vec3 normal;
+		float dist;
+		int type;
+	};
+
+	struct ClipNode
+	{
+		int plane;
+		int children[2];
+	};
+
+	struct Model
+	{
+		glm::vec3 mins;
+		glm::vec3 maxs;
+		int head_nodes[4];
+	};
+
+	void loadLadders(const std::string& entities);
+
+	TraceResult traceModel(const Model& model, const glm::vec3& begin, const glm::vec3& end, BspHull hull) const;
+	bool recursiveHullCheck(int head_node, int node, float p1f, float p2f, const glm::vec3& p1, const glm::vec3& p2, TraceResult& trace) const;
+	int getPointContents(int node, const glm::vec3& point) const;
+	float getPlaneDistance(const Plane& plane, const glm::vec3& point) const;
+
+private:
+	std::vector<Plane> mPlanes;
+	std::vector<ClipNode> mClipNodes;
+	std::vector<Model> mModels;
+	std::unordered_map<int, glm::vec3> mModelOrigins; // moved brush models
+	std::vector<Ladder> mLadders;
+};
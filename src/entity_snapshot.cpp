@@ -0,0 +1,135 @@
+#include "entity_snapshot.h"
+#include <algorithm>
+
+void EntitySnapshot::clear()
+{
+	// keep capacity, we refill these every tick
+	mPlayers.clear();
+	mBrushModels.clear();
+	mCells.clear();
+	mQueryScratch.clear();
+}
+
+void EntitySnapshot::addPlayer(int index, const HL::Protocol::Entity& entity)
+{
+	Player player;
+	player.index = index;
+	player.origin = entity.origin;
+	player.entity = entity;
+	mPlayers.push_back(player);
+}
+
+void EntitySnapshot::addBrushModel(int index, int bsp_model_index, const glm::vec3& origin)
+{
+	BrushModel model;
+	model.index = index;
+	model.bsp_model_index = bsp_model_index;
+	model.origin = origin;
+	mBrushModels.push_back(model);
+}
+
+void EntitySnapshot::buildPlayerGrid()
+{
+	mCells.clear();
+
+	auto get_key = [](const Player& player) {
+		return MakeCellKey(GetCellCoord(player.origin.x), GetCellCoord(player.origin.y));
+	};
+
+	// sort players by cell, ties by index so the order does not depend on the entity map
+
+	std::sort(mPlayers.begin(), mPlayers.end(), [&](const Player& a, const Player& b) {
+		auto key_a = get_key(a);
+		auto key_b = get_key(b);
+
+		if (key_a != key_b)
+			return key_a < key_b;
+
+		return a.index < b.index;
+	});
+
+	for (size_t i = 0; i < mPlayers.size(); i++)
+	{
+		auto key = get_key(mPlayers[i]);
+
+		if (mCells.empty() || mCells.back().key != key)
+			mCells.push_back({ key, i, 0 });
+
+		mCells.back().count += 1;
+	}
+}
+
+const EntitySnapshot::Player* EntitySnapshot::findNearestPlayer(const glm::vec3& pos, float max_distance) const
+{
+	return findNearestPlayer(pos, max_distance, [](const Player&) { return true; });
+}
+
+void EntitySnapshot::findPlayersInRadius(const glm::vec3& pos, float radius, std::vector<const Player*>& result, bool sorted) const
+{
+	result.clear();
+
+	auto min_x = GetCellCoord(pos.x - radius);
+	auto max_x = GetCellCoord(pos.x + radius);
+	auto min_y = GetCellCoord(pos.y - radius);
+	auto max_y = GetCellCoord(pos.y + radius);
+
+	auto cells_in_range = (size_t)(max_x - min_x + 1) * (size_t)(max_y - min_y + 1);
+
+	auto try_add = [&](const Player& player) {
+		if (glm::distance(pos, player.origin) < radius)
+			result.push_back(&player);
+	};
+
+	// for big radiuses the grid does not help, walking everything is cheaper
+
+	if (cells_in_range >= mCells.size())
+	{
+		for (const auto& player : mPlayers)
+			try_add(player);
+	}
+	else
+	{
+		for (int x = min_x; x <= max_x; x++)
+		{
+			for (int y = min_y; y <= max_y; y++)
+			{
+				auto cell = findCell(MakeCellKey(x, y));
+
+				if (cell == nullptr)
+					continue;
+
+				for (size_t i = cell->first; i < cell->first + cell->count; i++)
+					try_add(mPlayers[i]);
+			}
+		}
+	}
+
+	if (!sorted)
+		return;
+
+	std::sort(result.begin(), result.end(), [&](const Player* a, const Player* b) {
+		return glm::distance(pos, a->origin) < glm::distance(pos, b->origin);
+	});
+}
+
+int EntitySnapshot::GetCellCoord(float value)
+{
+	return (int)glm::floor(value / PlayerGridCellSize);
+}
+
+uint64_t EntitySnapshot::MakeCellKey(int x, int y)
+{
+	return ((uint64_t)(uint32_t)x << 32) | (uint64_t)(uint32_t)y;
+}
+
+const EntitySnapshot::Cell* EntitySnapshot::findCell(uint64_t key) const
+{
+	auto it = std::lower_bound(mCells.begin(), mCells.end(), key, [](const Cell& cell, uint64_t key) {
+		return cell.key < key;
+	});
+
+	if (it == mCells.end() || it->key != key)
+		return nullptr;
+
+	return &(*it);
+}
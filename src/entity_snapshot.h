@@ -0,0 +1,75 @@
+#pragma once
+
+#include <HL/playable_client.h>
+#include <vector>
+
+// compact view of the entities for one think tick, built once and shared by all consumers.
+// players are kept in a small uniform grid, sorted by cell, so radius queries touch only nearby cells
+
+class EntitySnapshot
+{
+public:
+	static constexpr float PlayerGridCellSize = 256.0f;
+
+public:
+	struct Player
+	{
+		int index = 0;
+		glm::vec3 origin = { 0.0f, 0.0f, 0.0f };
+		HL::Protocol::Entity entity = {}; // a copy, the snapshot must not point into live client state
+	};
+
+	struct BrushModel
+	{
+		int index = 0;
+		int bsp_model_index = 0;
+		glm::vec3 origin = { 0.0f, 0.0f, 0.0f };
+	};
+
+public:
+	void clear();
+	void addPlayer(int index, const HL::Protocol::Entity& entity);
+	void addBrushModel(int index, int bsp_model_index, const glm::vec3& origin);
+	void buildPlayerGrid();
+
+public:
+	const Player* findNearestPlayer(const glm::vec3& pos, float max_distance) const;
+	void findPlayersInRadius(const glm::vec3& pos, float radius, std::vector<const Player*>& result, bool sorted = false) const;
+
+	// nearest player that passes the filter, the filter is called in order of distance,
+	// so expensive checks (like visibility traces) stop at the first match
+	template <typename F> const Player* findNearestPlayer(const glm::vec3& pos, float max_distance, F&& filter) const
+	{
+		findPlayersInRadius(pos, max_distance, mQueryScratch, true);
+
+		for (auto player : mQueryScratch)
+		{
+			if (filter(*player))
+				return player;
+		}
+
+		return nullptr;
+	}
+
+public:
+	const auto& getPlayers() const { return mPlayers; }
+	const auto& getBrushModels() const { return mBrushModels; }
+
+private:
+	struct Cell
+	{
+		uint64_t key = 0;
+		size_t first = 0; // in mPlayers
+		size_t count = 0;
+	};
+
+	static int GetCellCoord(float value);
+	static uint64_t MakeCellKey(int x, int y);
+	const Cell* findCell(uint64_t key) const;
+
+private:
+	std::vector<Player> mPlayers; // sorted by cell after buildPlayerGrid()
+	std::vector<BrushModel> mBrushModels;
+	std::vector<Cell> mCells; // sorted by key
+	mutable std::vector<const Player*> mQueryScratch;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+
+// flight recorder dump layout, shared by FlightRecorder and tools/flight_decoder
+//
+// [Header][Record * record_count], records are in chronological order
+
+namespace FlightRecordFormat
+{
+	constexpr uint32_t Magic = 0x52465658; // "XVFR"
+	constexpr uint32_t Version = 1;
+	constexpr const char* Extension = ".xfr";
+
+	enum class Branch : uint8_t
+	{
+		None, // dead or nothing to do
+		AvoidPlayers,
+		CustomTarget,
+		Explore
+	};
+
+	enum StateFlags : uint8_t
+	{
+		Alive = 1 << 0,
+		OnGround = 1 << 1,
+		Ducking = 1 << 2,
+		Spectator = 1 << 3
+	};
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t record_size;
+		uint32_t record_count;
+	};
+
+#pragma pack(push, 1)
+	struct Record
+	{
+		uint64_t time; // microseconds since the recorder was created
+
+		// input snapshot
+		float origin[3];
+		float speed;
+		float health;
+		uint8_t state; // StateFlags
+		uint8_t players;
+
+		// decision
+		uint8_t branch; // Branch
+		uint8_t reserved;
+		uint16_t chain_length;
+		uint16_t buttons;
+		uint32_t traces;
+		uint32_t expansions;
+		float forwardmove;
+		float sidemove;
+		float upmove;
+		float viewangles[2]; // pitch, yaw
+
+		// phase timings in microseconds
+		uint32_t nav_mesh_time;
+		uint32_t movement_time;
+		uint32_t tick_time;
+	};
+#pragma pack(pop)
+}
@@ -0,0 +1,52 @@
+#include "flight_recorder.h"
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+
+bool FlightRecorder::dump(const std::string& path, Clock::Duration duration) const
+{
+	auto available = std::min<uint64_t>(mCount, Capacity);
+	auto now = (uint64_t)Clock::ToMicroseconds(Clock::Now() - mStartTime);
+	auto window = (uint64_t)Clock::ToMicroseconds(duration);
+
+	// walk back from the newest record until we leave the requested window
+	uint64_t count = 0;
+
+	while (count < available)
+	{
+		const auto& record = mRecords[(mCount - count - 1) & (Capacity - 1)];
+
+		if (now - record.time > window)
+			break;
+
+		count += 1;
+	}
+
+	FlightRecordFormat::Header header;
+	header.magic = FlightRecordFormat::Magic;
+	header.version = FlightRecordFormat::Version;
+	header.record_size = sizeof(FlightRecordFormat::Record);
+	header.record_count = (uint32_t)count;
+
+	auto temp_path = path + ".tmp";
+
+	{
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+
+		if (!file)
+			return false;
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		for (auto i = mCount - count; i < mCount; i++)
+			file.write(reinterpret_cast<const char*>(&mRecords[i & (Capacity - 1)]), sizeof(FlightRecordFormat::Record));
+
+		if (!file)
+			return false;
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(temp_path, path, ec);
+
+	return !ec;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "flight_record_format.h"
+#include <common/clock.h>
+#include <array>
+#include <string>
+
+// always-on ring of the last think ticks, recording is a single copy into preallocated memory.
+// the writer and dump() must not run concurrently, the owner serializes them (see AiClient::getThinkMutex)
+
+class FlightRecorder
+{
+public:
+	static constexpr size_t Capacity = 8192; // a power of two, ~4.5 minutes at the default think rate
+
+public:
+	void record(FlightRecordFormat::Record& record)
+	{
+		record.time = Clock::ToMicroseconds(Clock::Now() - mStartTime);
+		mRecords[mCount & (Capacity - 1)] = record;
+		mCount += 1;
+	}
+
+	bool dump(const std::string& path, Clock::Duration duration) const;
+
+	auto getCount() const { return mCount; }
+	const auto& getLast() const { return mRecords[(mCount - 1) & (Capacity - 1)]; } // after the first record() only
+
+private:
+	Clock::TimePoint mStartTime = Clock::Now();
+	std::array<FlightRecordFormat::Record, Capacity> mRecords;
+	uint64_t mCount = 0;
+};
@@ -0,0 +1,190 @@
+#include "flow_field.h"
+#include <algorithm>
+#include <limits>
+
+FlowField::FlowField(const glm::vec3& destination) :
+	mDestination(destination)
+{
+}
+
+bool FlowField::build(const NavMesh& mesh, const CostFunction& get_cost)
+{
+	mEntries.clear();
+	mQueue.clear();
+
+	auto area = mesh.findExactArea(mDestination, 1.0f);
+
+	if (area == nullptr)
+		return false;
+
+	relax(area, area->position, 0.0f);
+	propagate(mesh, get_cost);
+
+	mTileVersions = mesh.getTileVersions();
+	mPenaltiesVersion = mesh.getPenaltiesVersion();
+	return true;
+}
+
+void FlowField::patch(const NavMesh& mesh, const CostFunction& get_cost)
+{
+	// every area of a changed tile takes the best of its links and passes it on
+
+	for (const auto& [key, version] : mesh.getTileVersions())
+	{
+		auto it = mTileVersions.find(key);
+
+		if (it != mTileVersions.end() && it->second == version)
+			continue;
+
+		for (auto area : mesh.getTileAreas(key))
+		{
+			pull(mesh, area, get_cost);
+
+			auto entry = mEntries.find(NavMesh::GetPositionKey(area->position));
+
+			if (entry == mEntries.end())
+				continue;
+
+			mQueue.push_back({ entry->second.distance, area });
+			std::push_heap(mQueue.begin(), mQueue.end(), std::greater<>{});
+		}
+	}
+
+	propagate(mesh, get_cost);
+	mTileVersions = mesh.getTileVersions();
+}
+
+bool FlowField::isStale(const NavMesh& mesh) const
+{
+	const auto& versions = mesh.getTileVersions();
+
+	if (versions.size() != mTileVersions.size())
+		return true;
+
+	for (const auto& [key, version] : versions)
+	{
+		auto it = mTileVersions.find(key);
+
+		if (it == mTileVersions.end() || it->second != version)
+			return true;
+	}
+
+	return false;
+}
+
+bool FlowField::isOutdated(const NavMesh& mesh) const
+{
+	return mesh.getPenaltiesVersion() != mPenaltiesVersion;
+}
+
+const FlowField::Entry* FlowField::find(const glm::vec3& position) const
+{
+	auto it = mEntries.find(NavMesh::GetPositionKey(position));
+
+	if (it == mEntries.end())
+		return nullptr;
+
+	return &it->second;
+}
+
+void FlowField::relax(NavArea* area, const glm::vec3& next, float distance)
+{
+	auto [it, inserted] = mEntries.try_emplace(NavMesh::GetPositionKey(area->position), Entry{ std::numeric_limits<float>::max() });
+
+	if (distance >= it->second.distance)
+		return;
+
+	it->second.distance = distance;
+	it->second.next = next;
+	mQueue.push_back({ distance, area });
+	std::push_heap(mQueue.begin(), mQueue.end(), std::greater<>{});
+}
+
+void FlowField::pull(const NavMesh& mesh, NavArea* area, const CostFunction& get_cost)
+{
+	for (auto dir : Directions)
+	{
+		auto link = area->getLink(dir);
+
+		if (link == nullptr || link->area->getNeighbour(OppositeDirections.at(dir)) != area)
+			continue; // two-way links only, like the planners
+
+		auto entry = find(link->area->position);
+
+		if (entry == nullptr)
+			continue;
+
+		auto cost = get_cost(area, *link);
+
+		if (cost < 0.0f)
+			continue;
+
+		relax(area, link->area->position, entry->distance + cost);
+	}
+
+	if (auto ladder_neighbour = mesh.findLadderNeighbour(area); ladder_neighbour != nullptr)
+	{
+		auto entry = find(ladder_neighbour->position);
+
+		if (entry == nullptr)
+			return;
+
+		NavLink link;
+		link.area = ladder_neighbour;
+		link.traversal = NavTraversal::Ladder;
+
+		auto cost = get_cost(area, link);
+
+		if (cost >= 0.0f)
+			relax(area, ladder_neighbour->position, entry->distance + cost);
+	}
+}
+
+void FlowField::propagate(const NavMesh& mesh, const CostFunction& get_cost)
+{
+	// reverse dijkstra, from an area to every area that has a link into it
+
+	while (!mQueue.empty())
+	{
+		std::pop_heap(mQueue.begin(), mQueue.end(), std::greater<>{});
+		auto [distance, area] = mQueue.back();
+		mQueue.pop_back();
+
+		auto entry = find(area->position);
+
+		if (entry == nullptr || distance > entry->distance)
+			continue; // pushed again with a better distance
+
+		for (auto dir : Directions)
+		{
+			auto from = area->getNeighbour(dir);
+
+			if (from == nullptr)
+				continue;
+
+			auto link = from->getLink(OppositeDirections.at(dir)); // the way we will actually walk
+
+			if (link == nullptr || link->area != area)
+				continue;
+
+			auto cost = get_cost(from, *link);
+
+			if (cost < 0.0f)
+				continue;
+
+			relax(from, area->position, distance + cost);
+		}
+
+		if (auto from = mesh.findLadderNeighbour(area); from != nullptr)
+		{
+			NavLink link;
+			link.area = area;
+			link.traversal = NavTraversal::Ladder;
+
+			auto cost = get_cost(from, link);
+
+			if (cost >= 0.0f)
+				relax(from, area->position, distance + cost); // ladders go both ways
+		}
+	}
+}
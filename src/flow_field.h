@@ -0,0 +1,47 @@
+#pragma once
+
+#include "nav_mesh.h"
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+// next hop towards one destination for every area that can reach it, from a single reverse dijkstra pass.
+// entries are keyed by area position, so they survive tile paging.
+// links are only ever added to the mesh, so distances only go down and a field is patched by relaxing
+// the areas of the tiles that changed since. penalties make paths longer, they need a new build
+
+class FlowField
+{
+public:
+	struct Entry
+	{
+		float distance = 0.0f; // path cost to the destination
+		glm::vec3 next = { 0.0f, 0.0f, 0.0f }; // position of the next area, the destination points to itself
+	};
+
+	using CostFunction = std::function<float(const NavArea* area, const NavLink& link)>; // negative for links we do not take
+
+public:
+	FlowField(const glm::vec3& destination);
+
+	bool build(const NavMesh& mesh, const CostFunction& get_cost); // false when the destination area is not resident
+	void patch(const NavMesh& mesh, const CostFunction& get_cost);
+	bool isStale(const NavMesh& mesh) const;
+	bool isOutdated(const NavMesh& mesh) const; // penalties changed, patching is not enough
+
+	const Entry* find(const glm::vec3& position) const;
+	const auto& getDestination() const { return mDestination; }
+	size_t getEntriesCount() const { return mEntries.size(); }
+
+private:
+	void relax(NavArea* area, const glm::vec3& next, float distance);
+	void pull(const NavMesh& mesh, NavArea* area, const CostFunction& get_cost);
+	void propagate(const NavMesh& mesh, const CostFunction& get_cost);
+
+private:
+	glm::vec3 mDestination;
+	std::unordered_map<uint64_t, Entry> mEntries;
+	std::unordered_map<NavMesh::TileKey, uint32_t> mTileVersions; // as of the last build or patch
+	uint32_t mPenaltiesVersion = 0;
+	std::vector<std::pair<float, NavArea*>> mQueue; // min heap, only used inside build and patch
+};
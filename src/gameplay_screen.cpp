@@ -65,6 +65,11 @@ void GameplayViewNode::drawTrivialMovement(Scene::Node& holder)
 
 	end_pos.value().z = start_pos.z;
 
+	std::unique_lock lock(CLIENT->getThinkMutex(), std::try_to_lock);
+
+	if (!lock.owns_lock())
+		return;
+
 	auto trace_result = CLIENT->traceLine(start_pos, end_pos.value());
 
 	auto mid_pos = trace_result.endpos;
@@ -120,6 +125,12 @@ void GameplayViewNode::drawNavMovement(Scene::Node& holder)
 		if (CLIENT->getState() != HL::BaseClient::State::GameStarted)
 			return;
 
+		// the think logic may be running on its own thread, skip a frame rather than wait for it
+		std::unique_lock lock(CLIENT->getThinkMutex(), std::try_to_lock);
+
+		if (!lock.owns_lock())
+			return;
+
 		GRAPHICS->draw(nullptr, nullptr, skygfx::utils::MeshBuilder::Mode::Lines, [&](auto vertex) {
 			static std::vector<glm::vec3> g_chain;
 
@@ -136,9 +147,8 @@ void GameplayViewNode::drawNavMovement(Scene::Node& holder)
 
 			for (int i = 0; i < g_chain.size(); i++)
 			{
-				auto chain_area = *std::next(chain.begin(), i);
-				g_chain[i] = sky::ease_towards(g_chain.at(i), chain_area->position, dTime);
-				//g_chain[i] = std::next(chain.begin(), i)->lock()->position;
+				auto chain_pos = chain.at(chain.size() - 1 - i).position; // next waypoint is at the back
+				g_chain[i] = sky::ease_towards(g_chain.at(i), chain_pos, dTime);
 			}
 
 			std::optional<glm::vec3> prev_v;
@@ -275,13 +285,23 @@ void GameplayViewNode::draw2dNavMesh(Scene::Node& holder)
 		if (CLIENT->getState() != HL::BaseClient::State::GameStarted)
 			return;
 
+		std::unique_lock lock(CLIENT->getThinkMutex(), std::try_to_lock);
+
+		if (!lock.owns_lock())
+			return;
+
 		const auto& nav = CLIENT->getNavMesh();
 
+		std::shared_lock nav_lock(nav.getMutex(), std::try_to_lock);
+
+		if (!nav_lock.owns_lock())
+			return;
+
 		if (mDraw2dNavmesh == 1)
 		{
-			NavMesh::AreaSet border_areas;
+			std::unordered_set<NavArea*> border_areas;
 
-			for (auto area : nav.explored_areas)
+			for (auto area : nav.getExploredAreas())
 			{
 				if (!area->isBorder())
 					continue;
@@ -306,42 +326,36 @@ void GameplayViewNode::draw2dNavMesh(Scene::Node& holder)
 				return;
 
 			GRAPHICS->draw(nullptr, nullptr, skygfx::utils::MeshBuilder::Mode::Lines, [&](auto vertex) {
-				std::function<void(std::shared_ptr<NavArea>)> recursiveBorderDraw = [&](std::shared_ptr<NavArea> area) {
+				std::function<void(NavArea*)> recursiveBorderDraw = [&](NavArea* area) {
 					border_areas.erase(area);
 
-					NavMesh::AreaSet targets;
+					std::unordered_set<NavArea*> targets;
 
-					for (auto [dir, neighbour] : area->neighbours)
+					for (auto dir : Directions)
 					{
-						if (!neighbour.has_value())
-							continue;
+						auto neighbour = area->getNeighbour(dir);
 
-						auto neighbour_nn = neighbour.value().lock();
+						if (neighbour == nullptr)
+							continue;
 
-						targets.insert(neighbour_nn);
+						targets.insert(neighbour);
 					}
 
 					for (auto horz_dir : { NavDirection::Left, NavDirection::Right })
 					{
-						if (!area->neighbours.contains(horz_dir))
-							continue;
+						auto horz_neighbour = area->getNeighbour(horz_dir);
 
-						if (!area->neighbours.at(horz_dir).has_value())
+						if (horz_neighbour == nullptr)
 							continue;
 
-						auto horz_neighbour_nn = area->neighbours.at(horz_dir).value().lock();
-
 						for (auto vert_dir : { NavDirection::Forward, NavDirection::Back })
 						{
-							if (!horz_neighbour_nn->neighbours.contains(vert_dir))
-								continue;
+							auto diagonal_neighbour = horz_neighbour->getNeighbour(vert_dir);
 
-							if (!horz_neighbour_nn->neighbours.at(vert_dir).has_value())
+							if (diagonal_neighbour == nullptr)
 								continue;
 
-							auto diagonal_neighbour_nn = horz_neighbour_nn->neighbours.at(vert_dir).value().lock();
-
-							targets.insert(diagonal_neighbour_nn);
+							targets.insert(diagonal_neighbour);
 						}
 					}
 
@@ -370,47 +384,37 @@ void GameplayViewNode::draw2dNavMesh(Scene::Node& holder)
 		}
 		else
 		{
-			const auto& areas = mDraw2dNavmesh == 2 ? nav.explored_areas : nav.unexplored_areas;
+			const auto& areas = mDraw2dNavmesh == 2 ? nav.getExploredAreas() : nav.getUnexploredAreas();
 
 			if (areas.empty())
 				return;
 
 
 			GRAPHICS->draw(nullptr, nullptr, skygfx::utils::MeshBuilder::Mode::Lines, [&](auto vertex) {
-				using NavAreaIndex = size_t;
-
-				std::unordered_set<NavAreaIndex> blacklist;
+				std::unordered_set<NavArea*> blacklist;
 
 				for (auto area : areas)
 				{
 					auto v1 = area->position;
 
-					auto area_index = reinterpret_cast<NavAreaIndex>(area.get());
-
-					blacklist.insert(area_index);
+					blacklist.insert(area);
 
 					for (auto dir : Directions)
 					{
-						if (!area->neighbours.contains(dir))
-							continue;
-
-						auto neighbour = area->neighbours.at(dir);
+						auto neighbour_nn = area->getNeighbour(dir);
 
-						if (!neighbour.has_value())
+						if (neighbour_nn == nullptr)
 							continue;
 
-						auto neighbour_nn = neighbour.value().lock();
-						auto neighbour_index = reinterpret_cast<NavAreaIndex>(neighbour_nn.get());
-
-						if (blacklist.contains(neighbour_index))
+						if (blacklist.contains(neighbour_nn))
 							continue;
 
 						auto opposite_dir = OppositeDirections.at(dir);
 
 						glm::vec4 color;
-						if (!neighbour_nn->neighbours.contains(opposite_dir))
+						if (!neighbour_nn->isProbed(opposite_dir))
 							color = { Graphics::Color::Red, 0.5f };
-						else if (!neighbour_nn->neighbours.at(opposite_dir).has_value())
+						else if (neighbour_nn->getNeighbour(opposite_dir) == nullptr)
 							color = { Graphics::Color::Blue, 0.5f };
 						else
 							color = { Graphics::Color::White, 0.5f };
@@ -0,0 +1,88 @@
+#include "influence_map.h"
+#include <algorithm>
+
+void InfluenceMap::stamp(const NavArea* area, float strength, Clock::TimePoint now)
+{
+	// breadth first over links, linear falloff with the number of steps.
+	// entries keep the strongest threat, so stamping the same player again does not pile up
+
+	mOpenList.clear();
+	mVisited.clear();
+	mOpenList.push_back({ area, 0 });
+	mVisited.push_back(area);
+
+	for (size_t i = 0; i < mOpenList.size(); i++)
+	{
+		auto [current, steps] = mOpenList[i];
+		auto value = strength * (1.0f - (float)steps / (float)(SpreadSteps + 1));
+		auto& entry = mEntries[GetKey(current->position)];
+		entry.position = current->position;
+		entry.value = std::max(Decay(entry, now), value);
+		entry.time = now;
+
+		if (steps >= SpreadSteps)
+			continue;
+
+		for (auto dir : Directions)
+		{
+			auto neighbour = current->getNeighbour(dir);
+
+			if (neighbour == nullptr)
+				continue;
+
+			if (std::find(mVisited.begin(), mVisited.end(), neighbour) != mVisited.end())
+				continue;
+
+			mVisited.push_back(neighbour);
+			mOpenList.push_back({ neighbour, steps + 1 });
+		}
+	}
+
+	if (mEntries.size() > mPruneSize)
+		prune(now);
+}
+
+float InfluenceMap::get(const NavArea* area, Clock::TimePoint now) const
+{
+	if (mEntries.empty())
+		return 0.0f;
+
+	auto it = mEntries.find(GetKey(area->position));
+
+	if (it == mEntries.end())
+		return 0.0f;
+
+	return Decay(it->second, now);
+}
+
+void InfluenceMap::clear()
+{
+	mEntries.clear();
+}
+
+InfluenceMap::Key InfluenceMap::GetKey(const glm::vec3& position)
+{
+	// areas sit on a grid of at least a few units, rounding keeps the key stable against float noise
+	auto x = (int32_t)glm::round(position.x);
+	auto y = (int32_t)glm::round(position.y);
+	auto z = (int32_t)glm::round(position.z / 4.0f);
+	return ((uint64_t)(uint32_t)x & 0x1fffff) | (((uint64_t)(uint32_t)y & 0x1fffff) << 21) | (((uint64_t)(uint32_t)z & 0x1fffff) << 42);
+}
+
+float InfluenceMap::Decay(const Entry& entry, Clock::TimePoint now)
+{
+	if (entry.value <= 0.0f)
+		return 0.0f;
+
+	auto elapsed = Clock::ToSeconds(now - entry.time);
+	return entry.value * glm::exp2(-elapsed / HalfLifeSeconds);
+}
+
+void InfluenceMap::prune(Clock::TimePoint now)
+{
+	std::erase_if(mEntries, [&](const auto& pair) {
+		return Decay(pair.second, now) < MinValue;
+	});
+
+	mPruneSize = std::max<size_t>(1024, mEntries.size() * 2);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "nav_mesh.h"
+#include <common/clock.h>
+#include <unordered_map>
+#include <vector>
+
+// threat around other players, one value per nav area.
+// areas are keyed by their grid position, so values survive tile paging.
+// values decay lazily: an entry remembers when it was written and reads scale it down by the elapsed time,
+// so a tick only touches the areas around players, never the whole mesh
+
+class InfluenceMap
+{
+public:
+	static constexpr float HalfLifeSeconds = 1.5f;
+	static constexpr int SpreadSteps = 4; // over neighbour links
+	static constexpr float MinValue = 0.01f; // below this an entry is dropped
+
+public:
+	void stamp(const NavArea* area, float strength, Clock::TimePoint now);
+	float get(const NavArea* area, Clock::TimePoint now) const;
+	void clear();
+
+	// func(const glm::vec3& position, float value) for every entry above MinValue, positions are area positions
+	template <typename F> void forEachEntry(Clock::TimePoint now, F&& func) const;
+
+	size_t getEntriesCount() const { return mEntries.size(); }
+
+private:
+	using Key = uint64_t;
+
+	struct Entry
+	{
+		glm::vec3 position = { 0.0f, 0.0f, 0.0f };
+		float value = 0.0f;
+		Clock::TimePoint time;
+	};
+
+	static Key GetKey(const glm::vec3& position);
+	static float Decay(const Entry& entry, Clock::TimePoint now);
+	void prune(Clock::TimePoint now);
+
+private:
+	std::unordered_map<Key, Entry> mEntries;
+	size_t mPruneSize = 1024; // prune when the map grows past this
+	std::vector<std::pair<const NavArea*, int>> mOpenList; // scratch, keeps stamp() free of allocations
+	std::vector<const NavArea*> mVisited;
+};
+
+template <typename F> void InfluenceMap::forEachEntry(Clock::TimePoint now, F&& func) const
+{
+	for (const auto& [key, entry] : mEntries)
+	{
+		auto value = Decay(entry, now);
+
+		if (value >= MinValue)
+			func(entry.position, value);
+	}
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+// loopback tcp for local tooling (nav stream, metrics exporter), plain sockets so tools can use it without sky
+
+namespace LocalSocket
+{
+	using Handle = intptr_t;
+
+	constexpr Handle Invalid = -1;
+
+	inline void Startup()
+	{
+#ifdef _WIN32
+		struct Library
+		{
+			Library() { WSADATA data; ::WSAStartup(MAKEWORD(2, 2), &data); }
+			~Library() { ::WSACleanup(); }
+		};
+
+		static Library library;
+#endif
+	}
+
+	inline void Close(Handle socket)
+	{
+#ifdef _WIN32
+		::closesocket((SOCKET)socket);
+#else
+		::close((int)socket);
+#endif
+	}
+
+	inline bool SetNonBlocking(Handle socket)
+	{
+#ifdef _WIN32
+		u_long mode = 1;
+		return ::ioctlsocket((SOCKET)socket, FIONBIO, &mode) == 0;
+#else
+		auto flags = ::fcntl((int)socket, F_GETFL, 0);
+		return flags != -1 && ::fcntl((int)socket, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+	}
+
+	inline bool IsWouldBlock()
+	{
+#ifdef _WIN32
+		return ::WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+		return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+	}
+
+	// non blocking listening socket on 127.0.0.1, Invalid on failure
+	inline Handle Listen(uint16_t port, int backlog)
+	{
+		Startup();
+
+		auto socket = (Handle)::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+		if (socket == Invalid)
+			return Invalid;
+
+		int reuse = 1;
+		::setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(port);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		if (::bind(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+			::listen(socket, backlog) != 0 || !SetNonBlocking(socket))
+		{
+			Close(socket);
+			return Invalid;
+		}
+
+		return socket;
+	}
+
+	// Invalid when nobody is waiting, accepted sockets are non blocking
+	inline Handle Accept(Handle listen_socket)
+	{
+		auto socket = (Handle)::accept(listen_socket, nullptr, nullptr);
+
+		if (socket == Invalid)
+			return Invalid;
+
+		if (!SetNonBlocking(socket))
+		{
+			Close(socket);
+			return Invalid;
+		}
+
+		int no_delay = 1;
+		::setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&no_delay), sizeof(no_delay));
+
+#ifdef SO_NOSIGPIPE
+		int no_sigpipe = 1;
+		::setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, &no_sigpipe, sizeof(no_sigpipe));
+#endif
+
+		return socket;
+	}
+
+	// bytes sent, 0 when the socket buffer is full, -1 when the peer is gone
+	inline int Send(Handle socket, const void* data, int size)
+	{
+#ifdef MSG_NOSIGNAL
+		auto result = ::send(socket, reinterpret_cast<const char*>(data), size, MSG_NOSIGNAL);
+#else
+		auto result = ::send(socket, reinterpret_cast<const char*>(data), size, 0);
+#endif
+
+		if (result > 0)
+			return (int)result;
+
+		if (result < 0 && IsWouldBlock())
+			return 0;
+
+		return -1;
+	}
+
+	// true when the socket can be read (or accepted from) within the timeout
+	inline bool WaitReadable(Handle socket, int timeout_ms)
+	{
+#ifdef _WIN32
+		WSAPOLLFD fd = { (SOCKET)socket, POLLRDNORM, 0 };
+		return ::WSAPoll(&fd, 1, timeout_ms) > 0;
+#else
+		pollfd fd = { (int)socket, POLLIN, 0 };
+		return ::poll(&fd, 1, timeout_ms) > 0;
+#endif
+	}
+}
@@ -0,0 +1,386 @@
+#include "map_prewarm.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+	constexpr float NavTileMinIdleSeconds = 10.0f; // tiles of a mesh someone still plays on stay resident
+
+	struct Entry
+	{
+		std::filesystem::path path;
+		std::unique_ptr<MapPrewarm::Prepared> prepared; // nullptr until loaded or after it was taken
+		bool loading = false;
+	};
+
+	struct State
+	{
+		~State()
+		{
+			{
+				std::lock_guard lock(mutex);
+				stopping = true;
+			}
+
+			condition.notify_all();
+
+			if (thread.joinable())
+				thread.join();
+		}
+
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::map<std::string, Entry> entries;
+		std::deque<std::string> queue;
+		std::deque<std::pair<MapStore::Hash, std::filesystem::path>> stores;
+		std::map<std::string, std::shared_ptr<SharedNavMesh>> nav_meshes; // by map
+		std::deque<std::weak_ptr<SharedNavMesh>> evictions;
+		std::thread thread;
+		bool stopping = false;
+
+		std::vector<std::string> cycle; // told
+		std::map<std::string, std::string> successors; // learned
+		std::map<std::string, std::filesystem::path> known_paths;
+		std::string last_map;
+		size_t capacity = MapPrewarm::DefaultCapacity;
+		MapPrewarm::Counters counters;
+	};
+
+	State& GetState()
+	{
+		static State state;
+		return state;
+	}
+
+	void Work(State& state)
+	{
+		std::unique_lock lock(state.mutex);
+
+		while (true)
+		{
+			state.condition.wait(lock, [&] {
+				return state.stopping || !state.queue.empty() || !state.stores.empty() || !state.evictions.empty();
+			});
+
+			if (state.stopping)
+				return;
+
+			// downloads first, other bots may be about to ask the store for them
+			if (!state.stores.empty())
+			{
+				auto [hash, path] = state.stores.front();
+				state.stores.pop_front();
+				lock.unlock();
+				MapStore::Store(hash, path);
+				lock.lock();
+				continue;
+			}
+
+			// a kept mesh goes to disk, with its components flattened, regions are merged again on page in
+			if (!state.evictions.empty())
+			{
+				auto nav_mesh = state.evictions.front().lock();
+				state.evictions.pop_front();
+
+				if (nav_mesh == nullptr)
+					continue;
+
+				lock.unlock();
+
+				{
+					std::unique_lock nav_lock(nav_mesh->getMutex());
+					nav_mesh->collectExploredAreas();
+
+					// we and the cache are the only holders, otherwise bots of another server still play on it
+					if (nav_mesh.use_count() <= 2)
+						nav_mesh->evictIdleTiles(Clock::Duration::zero());
+					else
+						nav_mesh->evictIdleTiles(Clock::FromSeconds(NavTileMinIdleSeconds));
+				}
+
+				nav_mesh.reset();
+				lock.lock();
+				continue;
+			}
+
+			auto map = state.queue.front();
+			state.queue.pop_front();
+
+			auto it = state.entries.find(map);
+
+			if (it == state.entries.end() || it->second.prepared != nullptr || it->second.loading)
+				continue;
+
+			auto path = it->second.path;
+			it->second.loading = true;
+			lock.unlock();
+
+			auto prepared = std::make_unique<MapPrewarm::Prepared>();
+			prepared->path = path;
+
+			std::error_code ec;
+			prepared->write_time = std::filesystem::last_write_time(path, ec);
+
+			if (!ec)
+			{
+				prepared->hash = MapStore::ComputeHash(path);
+				prepared->bsp_file.loadFromFile(path.string(), false);
+
+				if (!prepared->bsp_hulls.load(path.string()))
+					prepared->bsp_hulls.clear();
+			}
+			else
+			{
+				prepared.reset();
+			}
+
+			lock.lock();
+
+			// the entry could be dropped while we were loading
+			it = state.entries.find(map);
+
+			if (it != state.entries.end())
+			{
+				it->second.loading = false;
+				it->second.prepared = std::move(prepared);
+			}
+
+			state.condition.notify_all();
+		}
+	}
+
+	bool IsInCycle(const State& state, const std::string& map)
+	{
+		if (!state.cycle.empty())
+			return std::find(state.cycle.begin(), state.cycle.end(), MapPrewarm::NormalizeMapName(map)) != state.cycle.end();
+
+		if (map == state.last_map)
+			return true; // its successor is learned on the next map change
+
+		return std::any_of(state.successors.begin(), state.successors.end(), [&](const auto& pair) {
+			return pair.first == map || pair.second == map;
+		});
+	}
+
+	void StartWork(State& state)
+	{
+		if (!state.thread.joinable())
+			state.thread = std::thread(Work, std::ref(state));
+
+		state.condition.notify_all();
+	}
+
+	std::vector<std::string> GetUpcomingMaps(const State& state, const std::string& map)
+	{
+		auto get_next = [&](const std::string& current) -> std::optional<std::string> {
+			auto it = std::find(state.cycle.begin(), state.cycle.end(), current);
+
+			if (it != state.cycle.end())
+			{
+				it = std::next(it);
+				return it == state.cycle.end() ? state.cycle.front() : *it;
+			}
+
+			auto successor = state.successors.find(current);
+
+			if (successor != state.successors.end())
+				return successor->second;
+
+			return std::nullopt;
+		};
+
+		std::vector<std::string> result;
+		auto current = map;
+
+		while (result.size() < state.capacity)
+		{
+			auto next = get_next(current);
+
+			if (!next.has_value())
+				break;
+
+			if (std::find(result.begin(), result.end(), next.value()) != result.end())
+				break;
+
+			result.push_back(next.value());
+			current = next.value();
+		}
+
+		return result;
+	}
+}
+
+void MapPrewarm::SetCycle(const std::vector<std::string>& maps)
+{
+	auto& state = GetState();
+	std::lock_guard lock(state.mutex);
+	state.cycle.clear();
+
+	for (const auto& map : maps)
+		state.cycle.push_back(NormalizeMapName(map));
+}
+
+std::vector<std::string> MapPrewarm::GetCycle()
+{
+	auto& state = GetState();
+	std::lock_guard lock(state.mutex);
+	return state.cycle;
+}
+
+void MapPrewarm::SetCapacity(size_t capacity)
+{
+	auto& state = GetState();
+	std::lock_guard lock(state.mutex);
+	state.capacity = capacity;
+}
+
+size_t MapPrewarm::GetCapacity()
+{
+	auto& state = GetState();
+	std::lock_guard lock(state.mutex);
+	return state.capacity;
+}
+
+void MapPrewarm::OnMapStarted(const std::string& map, const std::filesystem::path& path, const std::filesystem::path& game_dir)
+{
+	auto& state = GetState();
+	std::lock_guard lock(state.mutex);
+
+	state.known_paths[map] = path;
+
+	if (!state.last_map.empty() && state.last_map != map)
+		state.successors[state.last_map] = map;
+
+	state.last_map = map;
+
+	auto upcoming = GetUpcomingMaps(state, map);
+
+	std::erase_if(state.entries, [&](const auto& pair) {
+		return std::find(upcoming.begin(), upcoming.end(), pair.first) == upcoming.end();
+	});
+
+	std::erase_if(state.queue, [&](const auto& queued) {
+		return !state.entries.contains(queued);
+	});
+
+	std::erase_if(state.nav_meshes, [&](const auto& pair) {
+		return !IsInCycle(state, pair.first);
+	});
+
+	for (const auto& upcoming_map : upcoming)
+	{
+		auto known_path = state.known_paths.find(upcoming_map);
+		auto upcoming_path = known_path != state.known_paths.end() ? known_path->second : game_dir / upcoming_map;
+
+		std::error_code ec;
+
+		if (!std::filesystem::exists(upcoming_path, ec))
+			continue; // not downloaded yet, nothing to prepare
+
+		auto& entry = state.entries[upcoming_map];
+
+		if (entry.path == upcoming_path && (entry.prepared != nullptr || entry.loading))
+			continue;
+
+		entry.path = upcoming_path;
+		entry.prepared.reset();
+		state.queue.push_back(upcoming_map);
+	}
+
+	if (state.queue.empty())
+		return;
+
+	StartWork(state);
+}
+
+void MapPrewarm::Store(const MapStore::Hash& hash, const std::filesystem::path& path)
+{
+	auto& state = GetState();
+	std::lock_guard lock(state.mutex);
+
+	state.stores.push_back({ hash, path });
+	StartWork(state);
+}
+
+void MapPrewarm::KeepNavMesh(std::shared_ptr<SharedNavMesh> nav_mesh)
+{
+	auto& state = GetState();
+	std::lock_guard lock(state.mutex);
+
+	const auto& map = nav_mesh->getMap();
+
+	if (!IsInCycle(state, map))
+		return;
+
+	state.evictions.push_back(nav_mesh);
+	state.nav_meshes[map] = std::move(nav_mesh);
+	StartWork(state);
+}
+
+std::unique_ptr<MapPrewarm::Prepared> MapPrewarm::Take(const std::string& map, const std::filesystem::path& path)
+{
+	auto& state = GetState();
+	std::unique_lock lock(state.mutex);
+
+	// a map in the middle of loading is worth the wait, a queued one is not
+	state.condition.wait(lock, [&] {
+		auto it = state.entries.find(map);
+		return it == state.entries.end() || !it->second.loading;
+	});
+
+	std::erase(state.queue, map);
+
+	auto it = state.entries.find(map);
+
+	if (it == state.entries.end() || it->second.prepared == nullptr)
+	{
+		state.counters.misses += 1;
+		return nullptr;
+	}
+
+	// the entry stays until the next map change, so the map is not queued again
+	auto prepared = std::move(it->second.prepared);
+
+	std::error_code ec;
+	auto write_time = std::filesystem::last_write_time(path, ec);
+
+	if (ec || prepared->path != path || prepared->write_time != write_time)
+	{
+		state.counters.misses += 1;
+		return nullptr;
+	}
+
+	state.counters.hits += 1;
+	return prepared;
+}
+
+MapPrewarm::Counters MapPrewarm::GetCounters()
+{
+	auto& state = GetState();
+	std::lock_guard lock(state.mutex);
+
+	auto result = state.counters;
+	result.cached = std::count_if(state.entries.begin(), state.entries.end(), [](const auto& pair) {
+		return pair.second.prepared != nullptr;
+	});
+	result.nav_meshes = state.nav_meshes.size();
+
+	return result;
+}
+
+std::string MapPrewarm::NormalizeMapName(const std::string& name)
+{
+	auto path = std::filesystem::path(name);
+
+	if (!path.has_extension())
+		path += ".bsp";
+
+	if (!path.has_parent_path())
+		path = std::filesystem::path("maps") / path;
+
+	return path.generic_string();
+}
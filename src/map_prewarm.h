@@ -0,0 +1,63 @@
+#pragma once
+
+#include <HL/bspfile.h>
+#include "bsp_hulls.h"
+#include "map_store.h"
+#include "shared_nav_mesh.h"
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// loads the maps the server is going to play next while we are busy with the current one.
+// the map cycle is told with map_cycle or learned from the map changes we see.
+// a background thread parses the bsp and the clip hulls of the upcoming maps, so on a map change the bot takes
+// ready objects instead of starting from nothing. nav meshes of maps that are left keep living here while
+// their map is in the cycle, paged out, so the next visit continues with what was learned on this one.
+// the same thread hashes and stores downloaded maps, see MapStore
+
+class MapPrewarm
+{
+public:
+	struct Prepared
+	{
+		std::filesystem::path path;
+		std::filesystem::file_time_type write_time;
+		std::optional<MapStore::Hash> hash; // of the file content
+		BSPFile bsp_file;
+		BspHulls bsp_hulls;
+	};
+
+	struct Counters
+	{
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t cached = 0; // prepared maps waiting in memory
+		size_t nav_meshes = 0; // kept for maps of the cycle
+	};
+
+	static constexpr size_t DefaultCapacity = 2;
+
+public:
+	static void SetCycle(const std::vector<std::string>& maps); // map names as the server announces them
+	static std::vector<std::string> GetCycle();
+
+	static void SetCapacity(size_t capacity);
+	static size_t GetCapacity();
+
+	// learns the cycle and starts preparing the maps that follow this one
+	static void OnMapStarted(const std::string& map, const std::filesystem::path& path, const std::filesystem::path& game_dir);
+
+	// counts a hit or a miss, waits when the map is being prepared right now
+	static std::unique_ptr<Prepared> Take(const std::string& map, const std::filesystem::path& path);
+
+	// MapStore::Store off the network thread, it reads the whole map
+	static void Store(const MapStore::Hash& hash, const std::filesystem::path& path);
+
+	// called by a bot leaving the map of the mesh, after it let go of it. bots coming back acquire the same mesh
+	static void KeepNavMesh(std::shared_ptr<SharedNavMesh> nav_mesh);
+
+	static Counters GetCounters();
+	static std::string NormalizeMapName(const std::string& name); // "de_dust2" -> "maps/de_dust2.bsp"
+};
@@ -0,0 +1,256 @@
+#include "map_store.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// rfc 1321
+
+	class Md5
+	{
+	public:
+		void update(const uint8_t* data, size_t size)
+		{
+			auto filled = (size_t)(mLength % 64);
+			mLength += size;
+
+			// top up a block left over from the previous call
+			if (filled > 0)
+			{
+				auto count = std::min(size, 64 - filled);
+				std::memcpy(mBlock + filled, data, count);
+				data += count;
+				size -= count;
+
+				if (filled + count < 64)
+					return;
+
+				transform(mBlock);
+			}
+
+			// whole blocks straight from the input
+			for (; size >= 64; data += 64, size -= 64)
+				transform(data);
+
+			std::memcpy(mBlock, data, size);
+		}
+
+		MapStore::Hash finish()
+		{
+			uint64_t bits = mLength * 8;
+
+			uint8_t padding[64 + 8] = { 0x80 };
+			auto padding_size = (size_t)((mLength % 64 < 56 ? 56 : 120) - mLength % 64);
+
+			for (int i = 0; i < 8; i++)
+				padding[padding_size + i] = (uint8_t)(bits >> (i * 8));
+
+			update(padding, padding_size + 8);
+
+			MapStore::Hash result;
+
+			for (int i = 0; i < 16; i++)
+				result[i] = (uint8_t)(mState[i / 4] >> ((i % 4) * 8));
+
+			return result;
+		}
+
+	private:
+		static uint32_t Rotate(uint32_t value, int count)
+		{
+			return (value << count) | (value >> (32 - count));
+		}
+
+		void transform(const uint8_t* block)
+		{
+			static const uint32_t K[64] = {
+				0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+				0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+				0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+				0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+				0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+				0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+				0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+				0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+			};
+
+			static const int S[64] = {
+				7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+				5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+				4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+				6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+			};
+
+			uint32_t m[16];
+
+			for (int i = 0; i < 16; i++)
+				m[i] = block[i * 4] | (block[i * 4 + 1] << 8) | (block[i * 4 + 2] << 16) | ((uint32_t)block[i * 4 + 3] << 24);
+
+			auto a = mState[0];
+			auto b = mState[1];
+			auto c = mState[2];
+			auto d = mState[3];
+
+			for (int i = 0; i < 64; i++)
+			{
+				uint32_t f;
+				int g;
+
+				if (i < 16)
+				{
+					f = (b & c) | (~b & d);
+					g = i;
+				}
+				else if (i < 32)
+				{
+					f = (d & b) | (~d & c);
+					g = (5 * i + 1) % 16;
+				}
+				else if (i < 48)
+				{
+					f = b ^ c ^ d;
+					g = (3 * i + 5) % 16;
+				}
+				else
+				{
+					f = c ^ (b | ~d);
+					g = (7 * i) % 16;
+				}
+
+				auto next = d;
+				d = c;
+				c = b;
+				b = b + Rotate(a + f + K[i] + m[g], S[i]);
+				a = next;
+			}
+
+			mState[0] += a;
+			mState[1] += b;
+			mState[2] += c;
+			mState[3] += d;
+		}
+
+	private:
+		uint32_t mState[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+		uint8_t mBlock[64] = { };
+		uint64_t mLength = 0;
+	};
+}
+
+std::optional<std::filesystem::path> MapStore::Find(const Hash& hash)
+{
+	if (!IsValidHash(hash))
+		return std::nullopt;
+
+	auto path = GetDirectory() / (HashToString(hash) + ".bsp");
+
+	std::error_code ec;
+
+	// content is verified once by Store before the file gets its name, and stored files are never
+	// written again, so the name alone can be trusted. this runs on the network thread while connecting
+	if (!std::filesystem::exists(path, ec))
+		return std::nullopt;
+
+	return path;
+}
+
+bool MapStore::Store(const Hash& hash, const std::filesystem::path& source)
+{
+	if (!IsValidHash(hash))
+		return false;
+
+	if (Find(hash).has_value())
+		return true;
+
+	if (ComputeHash(source) != hash)
+		return false;
+
+	auto directory = GetDirectory();
+
+	std::error_code ec;
+	std::filesystem::create_directories(directory, ec);
+
+	if (ec)
+		return false;
+
+	std::random_device random;
+	auto name = HashToString(hash);
+	auto temp_path = directory / (name + "." + std::to_string(random()) + std::to_string(random()) + ".tmp");
+	auto path = directory / (name + ".bsp");
+
+	std::filesystem::copy_file(source, temp_path, std::filesystem::copy_options::overwrite_existing, ec);
+
+	if (ec)
+	{
+		std::filesystem::remove(temp_path, ec);
+		return false;
+	}
+
+	// another process may have stored the same content meanwhile, any of the copies is fine
+	std::filesystem::rename(temp_path, path, ec);
+
+	if (ec)
+	{
+		std::filesystem::remove(temp_path, ec);
+		return std::filesystem::exists(path, ec);
+	}
+
+	return true;
+}
+
+std::optional<MapStore::Hash> MapStore::ComputeHash(const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ios::binary);
+
+	if (!file.is_open())
+		return std::nullopt;
+
+	Md5 md5;
+	std::vector<char> buffer(64 * 1024);
+
+	while (file)
+	{
+		file.read(buffer.data(), buffer.size());
+		md5.update((const uint8_t*)buffer.data(), (size_t)file.gcount());
+	}
+
+	if (file.bad())
+		return std::nullopt;
+
+	return md5.finish();
+}
+
+bool MapStore::IsValidHash(const Hash& hash)
+{
+	return std::any_of(hash.begin(), hash.end(), [](uint8_t byte) {
+		return byte != 0;
+	});
+}
+
+std::string MapStore::HashToString(const Hash& hash)
+{
+	static const char* Digits = "0123456789abcdef";
+	std::string result;
+
+	for (auto byte : hash)
+	{
+		result += Digits[byte >> 4];
+		result += Digits[byte & 0xf];
+	}
+
+	return result;
+}
+
+std::filesystem::path MapStore::GetDirectory()
+{
+	std::error_code ec;
+	auto temp = std::filesystem::temp_directory_path(ec);
+
+	if (ec)
+		return std::filesystem::path("temp") / "maps";
+
+	return temp / "xclient" / "maps";
+}
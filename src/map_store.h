@@ -0,0 +1,27 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+// content addressed store of downloaded maps, shared by every bot and every process on this machine.
+// a map is kept under the md5 of its content, so a copy is valid for any server that announces the same hash.
+// files are written under a unique temporary name and renamed into place, readers never see a partial file
+
+class MapStore
+{
+public:
+	using Hash = std::array<uint8_t, 16>;
+
+public:
+	static std::optional<std::filesystem::path> Find(const Hash& hash);
+	static bool Store(const Hash& hash, const std::filesystem::path& source);
+
+	static std::optional<Hash> ComputeHash(const std::filesystem::path& path);
+	static bool IsValidHash(const Hash& hash);
+	static std::string HashToString(const Hash& hash);
+
+	static std::filesystem::path GetDirectory();
+};
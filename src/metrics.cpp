@@ -0,0 +1,345 @@
+#include "metrics.h"
+#include "local_socket.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+	constexpr int ExporterPollMilliseconds = 250; // how fast the exporter notices it should stop
+	constexpr int RequestTimeoutMilliseconds = 1000;
+	constexpr size_t MaxRequestBytes = 4096;
+
+	struct Family
+	{
+		std::string help;
+		std::string type;
+		std::map<std::string, std::unique_ptr<Metrics::Series>> series; // by labels
+	};
+
+	struct State
+	{
+		~State()
+		{
+			stopExporter();
+		}
+
+		void stopExporter()
+		{
+			stopping = true;
+
+			if (thread.joinable())
+				thread.join();
+
+			if (listen_socket != LocalSocket::Invalid)
+				LocalSocket::Close(listen_socket);
+
+			listen_socket = LocalSocket::Invalid;
+			port = 0;
+			stopping = false;
+		}
+
+		std::mutex mutex; // families
+		std::map<std::string, Family> families;
+
+		std::mutex exporter_mutex;
+		std::thread thread;
+		std::atomic<bool> stopping = false;
+		LocalSocket::Handle listen_socket = LocalSocket::Invalid;
+		uint16_t port = 0;
+	};
+
+	State& GetState()
+	{
+		static State state;
+		return state;
+	}
+
+	template <typename T, typename F> T& GetSeries(const std::string& name, const std::string& help, const char* type, const std::string& labels, F&& make)
+	{
+		auto& state = GetState();
+		std::lock_guard lock(state.mutex);
+
+		auto& family = state.families[name];
+
+		if (family.type.empty())
+		{
+			family.help = help;
+			family.type = type;
+		}
+
+		assert(family.type == type); // one name, one type
+
+		auto& series = family.series[labels];
+
+		if (series == nullptr)
+			series = make();
+
+		return static_cast<T&>(*series);
+	}
+
+	void AppendNumber(std::string& out, double value)
+	{
+		if (std::isinf(value))
+		{
+			out += value > 0.0 ? "+Inf" : "-Inf";
+			return;
+		}
+
+		// shortest text that reads back the same, so bucket bounds stay readable
+		char buffer[32];
+		std::snprintf(buffer, sizeof(buffer), "%.15g", value);
+
+		if (std::strtod(buffer, nullptr) != value)
+			std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+
+		out += buffer;
+	}
+
+	void AppendSample(std::string& out, const std::string& name, const std::string& labels, double value)
+	{
+		out += name;
+
+		if (!labels.empty())
+			out += "{" + labels + "}";
+
+		out += ' ';
+		AppendNumber(out, value);
+		out += '\n';
+	}
+
+	bool SendAll(LocalSocket::Handle socket, const std::string& data)
+	{
+		size_t sent = 0;
+
+		while (sent < data.size())
+		{
+			auto result = LocalSocket::Send(socket, data.data() + sent, (int)(data.size() - sent));
+
+			if (result < 0)
+				return false;
+
+			if (result == 0)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1)); // scraper reads slower than we write
+				continue;
+			}
+
+			sent += (size_t)result;
+		}
+
+		return true;
+	}
+
+	void Serve(LocalSocket::Handle socket)
+	{
+		std::string request;
+
+		while (request.find("\r\n\r\n") == std::string::npos && request.size() < MaxRequestBytes)
+		{
+			if (!LocalSocket::WaitReadable(socket, RequestTimeoutMilliseconds))
+				return;
+
+			char buffer[1024];
+			auto result = ::recv(socket, buffer, sizeof(buffer), 0);
+
+			if (result <= 0)
+				return;
+
+			request.append(buffer, (size_t)result);
+		}
+
+		bool is_metrics = request.starts_with("GET /metrics ") || request.starts_with("GET /metrics?");
+
+		std::string body = is_metrics ? Metrics::Export() : "not found\n";
+		std::string response = is_metrics ? "HTTP/1.0 200 OK\r\n" : "HTTP/1.0 404 Not Found\r\n";
+		response += "Content-Type: text/plain; version=0.0.4\r\n";
+		response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+		response += "Connection: close\r\n\r\n";
+		response += body;
+
+		SendAll(socket, response);
+	}
+
+	void Work(State& state)
+	{
+		while (!state.stopping)
+		{
+			if (!LocalSocket::WaitReadable(state.listen_socket, ExporterPollMilliseconds))
+				continue;
+
+			auto socket = LocalSocket::Accept(state.listen_socket);
+
+			if (socket == LocalSocket::Invalid)
+				continue;
+
+			Serve(socket);
+			LocalSocket::Close(socket);
+		}
+	}
+}
+
+void Metrics::Counter::write(std::string& out, const std::string& name, const std::string& labels) const
+{
+	AppendSample(out, name, labels, (double)get());
+}
+
+void Metrics::Gauge::write(std::string& out, const std::string& name, const std::string& labels) const
+{
+	AppendSample(out, name, labels, get());
+}
+
+Metrics::Histogram::Histogram(std::span<const double> bounds) :
+	mBounds(bounds.begin(), bounds.end()),
+	mBuckets(std::make_unique<std::atomic<uint64_t>[]>(bounds.size() + 1))
+{
+	assert(std::is_sorted(mBounds.begin(), mBounds.end()));
+}
+
+void Metrics::Histogram::observe(double value)
+{
+	auto bucket = std::lower_bound(mBounds.begin(), mBounds.end(), value) - mBounds.begin();
+	mBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+	mCount.fetch_add(1, std::memory_order_relaxed);
+
+	// atomic<double>::fetch_add is missing from older standard libraries
+	auto sum = mSum.load(std::memory_order_relaxed);
+	while (!mSum.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed));
+}
+
+double Metrics::Histogram::getQuantile(double q) const
+{
+	// buckets are read one by one while others observe, the result is approximate anyway
+
+	uint64_t total = 0;
+
+	for (size_t i = 0; i <= mBounds.size(); i++)
+		total += mBuckets[i].load(std::memory_order_relaxed);
+
+	if (total == 0)
+		return 0.0;
+
+	auto rank = q * (double)total;
+	uint64_t cumulative = 0;
+
+	for (size_t i = 0; i < mBounds.size(); i++)
+	{
+		auto count = mBuckets[i].load(std::memory_order_relaxed);
+
+		if ((double)(cumulative + count) >= rank && count > 0)
+		{
+			auto lower = i == 0 ? 0.0 : mBounds[i - 1];
+			return lower + (mBounds[i] - lower) * (rank - (double)cumulative) / (double)count;
+		}
+
+		cumulative += count;
+	}
+
+	return mBounds.empty() ? 0.0 : mBounds.back(); // in the +inf bucket
+}
+
+void Metrics::Histogram::write(std::string& out, const std::string& name, const std::string& labels) const
+{
+	auto prefix = labels.empty() ? std::string() : labels + ",";
+	uint64_t cumulative = 0;
+
+	for (size_t i = 0; i <= mBounds.size(); i++)
+	{
+		cumulative += mBuckets[i].load(std::memory_order_relaxed);
+
+		std::string le;
+		AppendNumber(le, i < mBounds.size() ? mBounds[i] : INFINITY);
+		AppendSample(out, name + "_bucket", prefix + "le=\"" + le + "\"", (double)cumulative);
+	}
+
+	AppendSample(out, name + "_sum", labels, getSum());
+	AppendSample(out, name + "_count", labels, (double)cumulative); // consistent with the buckets, unlike getCount()
+}
+
+Metrics::Counter& Metrics::GetCounter(const std::string& name, const std::string& help, const std::string& labels)
+{
+	return GetSeries<Counter>(name, help, "counter", labels, [] {
+		return std::make_unique<Counter>();
+	});
+}
+
+Metrics::Gauge& Metrics::GetGauge(const std::string& name, const std::string& help, const std::string& labels)
+{
+	return GetSeries<Gauge>(name, help, "gauge", labels, [] {
+		return std::make_unique<Gauge>();
+	});
+}
+
+Metrics::Histogram& Metrics::GetHistogram(const std::string& name, const std::string& help, std::span<const double> bounds, const std::string& labels)
+{
+	return GetSeries<Histogram>(name, help, "histogram", labels, [&] {
+		return std::make_unique<Histogram>(bounds);
+	});
+}
+
+void Metrics::RemoveSeries(const std::string& labels)
+{
+	auto& state = GetState();
+	std::lock_guard lock(state.mutex);
+
+	for (auto& [name, family] : state.families)
+		family.series.erase(labels);
+
+	std::erase_if(state.families, [](const auto& pair) {
+		return pair.second.series.empty();
+	});
+}
+
+std::string Metrics::Export()
+{
+	auto& state = GetState();
+	std::lock_guard lock(state.mutex);
+
+	std::string result;
+
+	for (const auto& [name, family] : state.families)
+	{
+		result += "# HELP " + name + " " + family.help + "\n";
+		result += "# TYPE " + name + " " + family.type + "\n";
+
+		for (const auto& [labels, series] : family.series)
+			series->write(result, name, labels);
+	}
+
+	return result;
+}
+
+bool Metrics::Listen(uint16_t port)
+{
+	auto& state = GetState();
+	std::lock_guard lock(state.exporter_mutex);
+
+	state.stopExporter();
+
+	if (port == 0)
+		return true;
+
+	state.listen_socket = LocalSocket::Listen(port, 4);
+
+	if (state.listen_socket == LocalSocket::Invalid)
+		return false;
+
+	state.port = port;
+	state.thread = std::thread([&state] {
+		Work(state);
+	});
+
+	return true;
+}
+
+uint16_t Metrics::GetPort()
+{
+	auto& state = GetState();
+	std::lock_guard lock(state.exporter_mutex);
+	return state.port;
+}
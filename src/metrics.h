@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+// process-wide typed metrics, every bot of this process updates the same series.
+// series are made once (by name and labels) and then updated with relaxed atomics, no locks and no allocations.
+// text is only made when someone reads it: the stats overlay or the prometheus exporter (metrics_port)
+
+class Metrics
+{
+public:
+	class Series
+	{
+	public:
+		virtual ~Series() = default;
+		virtual void write(std::string& out, const std::string& name, const std::string& labels) const = 0;
+	};
+
+	class Counter : public Series
+	{
+	public:
+		void add(uint64_t value = 1) { mValue.fetch_add(value, std::memory_order_relaxed); }
+		uint64_t get() const { return mValue.load(std::memory_order_relaxed); }
+
+		void write(std::string& out, const std::string& name, const std::string& labels) const override;
+
+	private:
+		std::atomic<uint64_t> mValue = 0;
+	};
+
+	class Gauge : public Series
+	{
+	public:
+		void set(double value) { mValue.store(value, std::memory_order_relaxed); }
+		double get() const { return mValue.load(std::memory_order_relaxed); }
+
+		void write(std::string& out, const std::string& name, const std::string& labels) const override;
+
+	private:
+		std::atomic<double> mValue = 0.0;
+	};
+
+	// fixed buckets, quantiles are interpolated inside a bucket like prometheus does
+	class Histogram : public Series
+	{
+	public:
+		Histogram(std::span<const double> bounds); // upper bounds, ascending, +inf is implied
+
+		void observe(double value);
+		uint64_t getCount() const { return mCount.load(std::memory_order_relaxed); }
+		double getSum() const { return mSum.load(std::memory_order_relaxed); }
+		double getQuantile(double q) const;
+
+		void write(std::string& out, const std::string& name, const std::string& labels) const override;
+
+	private:
+		std::vector<double> mBounds;
+		std::unique_ptr<std::atomic<uint64_t>[]> mBuckets; // not cumulative, the last one is +inf
+		std::atomic<uint64_t> mCount = 0;
+		std::atomic<double> mSum = 0.0;
+	};
+
+	static constexpr double SecondsBuckets[] = { 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25 };
+
+public:
+	// labels are prometheus label pairs without braces, e.g. bot="1"
+	static Counter& GetCounter(const std::string& name, const std::string& help, const std::string& labels = "");
+	static Gauge& GetGauge(const std::string& name, const std::string& help, const std::string& labels = "");
+	static Histogram& GetHistogram(const std::string& name, const std::string& help, std::span<const double> bounds = SecondsBuckets, const std::string& labels = "");
+	static void RemoveSeries(const std::string& labels); // of a bot that goes away, references to them die
+
+	static std::string Export(); // prometheus text format
+
+	// http exporter on 127.0.0.1, any path but /metrics is 404. 0 stops it
+	static bool Listen(uint16_t port);
+	static uint16_t GetPort();
+};
@@ -0,0 +1,1102 @@
+#include "nav_mesh.h"
+#include "nav_tile_format.h"
+#include <cassert>
+#include <algorithm>
+#include <type_traits>
+#include <cstring>
+#include <fstream>
+
+template <typename F> void NavMesh::forEachTileKey(const glm::vec3& pos, float radius, F&& func) const
+{
+	auto min_x = (int32_t)glm::floor((pos.x - radius) / TileSize);
+	auto max_x = (int32_t)glm::floor((pos.x + radius) / TileSize);
+	auto min_y = (int32_t)glm::floor((pos.y - radius) / TileSize);
+	auto max_y = (int32_t)glm::floor((pos.y + radius) / TileSize);
+
+	for (auto x = min_x; x <= max_x; x++)
+	{
+		for (auto y = min_y; y <= max_y; y++)
+		{
+			func(((uint64_t)(uint32_t)x << 32) | (uint64_t)(uint32_t)y);
+		}
+	}
+}
+
+bool NavArea::isExplored() const
+{
+	for (const auto& neighbour : neighbours)
+	{
+		if (!neighbour.has_value())
+			return false;
+	}
+
+	return true;
+}
+
+bool NavArea::isBorder() const
+{
+	assert(isExplored());
+
+	for (auto dir : Directions)
+	{
+		auto neighbour = getNeighbour(dir);
+
+		if (neighbour != nullptr && neighbour->isExplored())
+			continue;
+
+		return true;
+	}
+
+	return false;
+}
+
+bool NavArea::isNeighbour(const NavArea* area) const
+{
+	for (auto dir : Directions)
+	{
+		if (getNeighbour(dir) != area)
+			continue;
+
+		return true;
+	}
+
+	return false;
+}
+
+bool NavArea::isProbed(NavDirection dir) const
+{
+	return neighbours.at(static_cast<size_t>(dir)).has_value();
+}
+
+NavArea* NavArea::getNeighbour(NavDirection dir) const
+{
+	const auto& neighbour = neighbours.at(static_cast<size_t>(dir));
+
+	if (!neighbour.has_value())
+		return nullptr;
+
+	return neighbour.value().area;
+}
+
+const NavLink* NavArea::getLink(NavDirection dir) const
+{
+	const auto& neighbour = neighbours.at(static_cast<size_t>(dir));
+
+	if (!neighbour.has_value() || neighbour.value().area == nullptr)
+		return nullptr;
+
+	return &neighbour.value();
+}
+
+const NavLink* NavArea::findLink(const NavArea* area) const
+{
+	for (auto dir : Directions)
+	{
+		auto link = getLink(dir);
+
+		if (link == nullptr || link->area != area)
+			continue;
+
+		return link;
+	}
+
+	return nullptr;
+}
+
+void NavArea::setNeighbour(NavDirection dir, const NavLink& link)
+{
+	auto& neighbour = neighbours.at(static_cast<size_t>(dir));
+
+	if (neighbour.has_value())
+		return;
+
+	neighbour = link;
+}
+
+void NavArea::addLinkPenalty(NavDirection dir, float penalty, Clock::TimePoint now)
+{
+	auto& neighbour = neighbours.at(static_cast<size_t>(dir));
+
+	if (!neighbour.has_value() || neighbour.value().area == nullptr)
+		return;
+
+	neighbour->penalty = neighbour->getPenalty(now) + penalty;
+	neighbour->penalty_time = now;
+}
+
+float NavLink::getPenalty(Clock::TimePoint now) const
+{
+	// decays, so links blocked by players or closed doors become usable again
+
+	if (penalty <= 0.0f)
+		return 0.0f;
+
+	return penalty * glm::exp2(-Clock::ToSeconds(now - penalty_time) / PenaltyHalfLifeSeconds);
+}
+
+NavMesh::NavMesh() :
+	mExploredAreas(&mArena),
+	mUnexploredAreas(&mArena)
+{
+}
+
+NavMesh::~NavMesh()
+{
+	clear();
+
+	if (mPageDirectory.has_value())
+	{
+		std::error_code ec;
+		std::filesystem::remove(mPageDirectory.value(), ec); // only if nothing else is left there
+	}
+}
+
+NavArea* NavMesh::createArea(const glm::vec3& position)
+{
+	auto key = GetTileKey(position);
+
+	if (mPagedTiles.contains(key))
+		pageInTile(key);
+
+	auto& tile = getTile(key);
+	std::pmr::polymorphic_allocator<NavArea> allocator(&tile.arena);
+	auto area = allocator.new_object<NavArea>();
+	area->position = position;
+	area->component_node = (uint32_t)mComponentParents.size();
+	mComponentParents.push_back(area->component_node);
+	mComponentRanks.push_back(0);
+	tile.areas.push_back(area);
+	addSingleRegion(tile, area);
+	markTileChanged(key);
+	mUnexploredAreas.push_back(area);
+	return area;
+}
+
+void NavMesh::collectExploredAreas()
+{
+	auto it = std::partition(mUnexploredAreas.begin(), mUnexploredAreas.end(), [](NavArea* area) {
+		return !area->isExplored();
+	});
+
+	mExploredAreas.insert(mExploredAreas.end(), it, mUnexploredAreas.end());
+	mUnexploredAreas.erase(it, mUnexploredAreas.end());
+
+	flattenComponents();
+}
+
+void NavMesh::clear()
+{
+	// NavArea is trivially destructible, so dropping the arenas is enough
+	static_assert(std::is_trivially_destructible_v<NavArea>);
+
+	{
+		std::lock_guard lock(mPrefetchesMutex);
+		mPrefetches.clear(); // waits for pending reads
+	}
+
+	if (mPageDirectory.has_value())
+	{
+		std::error_code ec;
+
+		for (const auto& [key, data] : mPagedTiles)
+			std::filesystem::remove(getTilePath(key), ec);
+	}
+
+	mTiles.clear();
+	mPagedTiles.clear();
+	mComponentParents.clear();
+	mComponentRanks.clear();
+	mComponentsFlattened = true;
+	mLadderLinks.clear();
+	mLaddersLinked = false;
+	mDirtyRegionTiles.clear();
+	mTileVersions.clear();
+	mExploredAreas = AreaList(&mArena);
+	mUnexploredAreas = AreaList(&mArena);
+	mArena.release();
+}
+
+NavArea* NavMesh::findExactArea(const glm::vec3& pos, float tolerance) const
+{
+	NavArea* result = nullptr;
+
+	forEachTileKey(pos, tolerance, [&](TileKey key) {
+		auto tile = findTile(key);
+
+		if (result != nullptr || tile == nullptr)
+			return;
+
+		result = FindExactArea(tile->areas, pos, tolerance);
+	});
+
+	return result;
+}
+
+void NavMesh::connectAreas(NavArea* a, NavArea* b)
+{
+	markTileChanged(GetTileKey(a->position));
+	markTileChanged(GetTileKey(b->position));
+
+	auto a_to_b = a->findLink(b);
+	auto b_to_a = b->findLink(a);
+
+	if (a_to_b == nullptr || b_to_a == nullptr)
+		return; // one-way links do not join components, we never plan over them
+
+	unionComponents(a->component_node, b->component_node);
+}
+
+void NavMesh::addLadderLink(NavArea* a, NavArea* b)
+{
+	mLadderLinks[GetPositionKey(a->position)] = b->position;
+	mLadderLinks[GetPositionKey(b->position)] = a->position;
+	unionComponents(a->component_node, b->component_node);
+}
+
+std::optional<glm::vec3> NavMesh::getLadderTarget(const NavArea* area) const
+{
+	if (mLadderLinks.empty())
+		return std::nullopt;
+
+	auto it = mLadderLinks.find(GetPositionKey(area->position));
+
+	if (it == mLadderLinks.end())
+		return std::nullopt;
+
+	return it->second;
+}
+
+NavArea* NavMesh::findLadderNeighbour(const NavArea* area) const
+{
+	auto target = getLadderTarget(area);
+
+	if (!target.has_value())
+		return nullptr;
+
+	return findExactArea(target.value(), 1.0f);
+}
+
+void NavMesh::unionComponents(uint32_t node_a, uint32_t node_b)
+{
+	auto root_a = findComponentRoot(node_a);
+	auto root_b = findComponentRoot(node_b);
+
+	if (root_a == root_b)
+		return;
+
+	if (mComponentRanks[root_a] < mComponentRanks[root_b])
+		std::swap(root_a, root_b);
+
+	mComponentParents[root_b] = root_a;
+
+	if (mComponentRanks[root_a] == mComponentRanks[root_b])
+		mComponentRanks[root_a] += 1;
+
+	mComponentsFlattened = false;
+}
+
+uint32_t NavMesh::getComponent(const NavArea* area) const
+{
+	// no path compression here, readers only hold a shared lock.
+	// union by rank keeps this short, and flattenComponents() makes it a single step again
+	auto node = area->component_node;
+
+	while (mComponentParents[node] != node)
+		node = mComponentParents[node];
+
+	return node;
+}
+
+bool NavMesh::isReachable(const NavArea* a, const NavArea* b) const
+{
+	return getComponent(a) == getComponent(b);
+}
+
+uint32_t NavMesh::findComponentRoot(uint32_t node)
+{
+	auto root = node;
+
+	while (mComponentParents[root] != root)
+		root = mComponentParents[root];
+
+	while (mComponentParents[node] != root)
+	{
+		auto next = mComponentParents[node];
+		mComponentParents[node] = root;
+		node = next;
+	}
+
+	return root;
+}
+
+void NavMesh::flattenComponents()
+{
+	if (mComponentsFlattened)
+		return;
+
+	for (uint32_t node = 0; node < (uint32_t)mComponentParents.size(); node++)
+		findComponentRoot(node);
+
+	mComponentsFlattened = true;
+}
+
+void NavMesh::setPageDirectory(const std::filesystem::path& path)
+{
+	std::error_code ec;
+	std::filesystem::create_directories(path, ec);
+
+	if (ec)
+		return; // keep the compact tiles in memory then
+
+	mPageDirectory = path;
+}
+
+void NavMesh::requireTiles(const glm::vec3& pos, float radius)
+{
+	auto now = Clock::Now();
+
+	forEachTileKey(pos, radius, [&](TileKey key) {
+		if (mPagedTiles.contains(key))
+			pageInTile(key);
+
+		auto it = mTiles.find(key);
+
+		if (it != mTiles.end())
+			it->second->last_used_time = now;
+	});
+}
+
+void NavMesh::prefetchTiles(const glm::vec3& pos, float radius)
+{
+	std::lock_guard lock(mPrefetchesMutex);
+
+	forEachTileKey(pos, radius, [&](TileKey key) {
+		auto paged = mPagedTiles.find(key);
+
+		if (paged == mPagedTiles.end() || mPrefetches.contains(key))
+			return;
+
+		// tiles paged out into memory have nothing to read, they are decoded at integration
+
+		if (!paged->second.empty() || !mPageDirectory.has_value())
+		{
+			mPrefetches.insert({ key, std::async(std::launch::deferred, [] { return std::vector<uint8_t>(); }) });
+			return;
+		}
+
+		mPrefetches.insert({ key, std::async(std::launch::async, [path = getTilePath(key)] {
+			std::ifstream file(path, std::ios::binary);
+			return std::vector<uint8_t>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		}) });
+	});
+}
+
+void NavMesh::integratePrefetchedTiles()
+{
+	std::vector<std::pair<TileKey, std::vector<uint8_t>>> ready;
+
+	{
+		std::lock_guard lock(mPrefetchesMutex);
+
+		for (auto it = mPrefetches.begin(); it != mPrefetches.end();)
+		{
+			if (it->second.wait_for(std::chrono::seconds(0)) == std::future_status::timeout)
+			{
+				++it;
+				continue;
+			}
+
+			ready.push_back({ it->first, it->second.get() });
+			it = mPrefetches.erase(it);
+		}
+	}
+
+	for (auto& [key, data] : ready)
+	{
+		if (!mPagedTiles.contains(key))
+			continue;
+
+		// tiles paged out into memory come back empty, they have their data already
+		if (!data.empty())
+			mPagedTiles[key] = std::move(data);
+
+		pageInTile(key);
+	}
+}
+
+void NavMesh::evictTiles(size_t max_resident_bytes, Clock::Duration min_idle)
+{
+	if (max_resident_bytes == 0)
+		return;
+
+	auto resident_bytes = getResidentBytes();
+
+	if (resident_bytes <= max_resident_bytes)
+		return;
+
+	std::vector<std::pair<Clock::TimePoint, TileKey>> lru;
+
+	for (const auto& [key, tile] : mTiles)
+		lru.push_back({ tile->last_used_time, key });
+
+	std::sort(lru.begin(), lru.end());
+
+	auto now = Clock::Now();
+
+	for (auto [last_used_time, key] : lru)
+	{
+		if (resident_bytes <= max_resident_bytes)
+			break;
+
+		if (now - last_used_time < min_idle)
+			break; // everything after this one is even more recent
+
+		auto tile_bytes = mTiles.at(key)->areas.size() * sizeof(NavArea);
+		pageOutTile(key);
+		resident_bytes -= std::min(resident_bytes, tile_bytes);
+	}
+}
+
+void NavMesh::evictIdleTiles(Clock::Duration min_idle)
+{
+	auto now = Clock::Now();
+
+	std::vector<TileKey> idle;
+
+	for (const auto& [key, tile] : mTiles)
+	{
+		if (now - tile->last_used_time >= min_idle)
+			idle.push_back(key);
+	}
+
+	for (auto key : idle)
+		pageOutTile(key);
+}
+
+size_t NavMesh::getResidentBytes() const
+{
+	size_t result = 0;
+
+	for (const auto& [key, tile] : mTiles)
+		result += tile->areas.size() * sizeof(NavArea) + tile->regions.size() * sizeof(NavRegion);
+
+	return result;
+}
+
+NavArea* NavMesh::FindNearestArea(std::span<NavArea* const> areas, const glm::vec3& pos)
+{
+	float min_distance = 8192.0f;
+	NavArea* result = nullptr;
+	for (auto area : areas)
+	{
+		auto distance = glm::distance(pos, area->position);
+		if (distance < min_distance)
+		{
+			result = area;
+			min_distance = distance;
+		}
+	}
+	return result;
+}
+
+NavArea* NavMesh::FindExactArea(std::span<NavArea* const> areas, const glm::vec3& pos, float tolerance)
+{
+	for (auto area : areas)
+	{
+		auto distance = glm::distance(pos, area->position);
+		if (distance <= tolerance)
+			return area;
+	}
+	return nullptr;
+}
+
+std::span<NavArea* const> NavMesh::getTileAreas(TileKey key) const
+{
+	auto tile = findTile(key);
+
+	if (tile == nullptr)
+		return {};
+
+	return tile->areas;
+}
+
+void NavMesh::markTileChanged(TileKey key)
+{
+	mDirtyRegionTiles.insert(key);
+	mTileVersions[key] += 1;
+}
+
+void NavMesh::markPenaltiesChanged(const NavArea* area, const NavArea* neighbour)
+{
+	// the link may run through a merged region, it is split on the next updateRegions()
+	mDirtyRegionTiles.insert(GetTileKey(area->position));
+	mDirtyRegionTiles.insert(GetTileKey(neighbour->position));
+	mPenaltiesVersion += 1;
+}
+
+void NavMesh::updateRegions(size_t max_tiles)
+{
+	for (size_t i = 0; i < max_tiles && !mDirtyRegionTiles.empty(); i++)
+	{
+		auto key = *mDirtyRegionTiles.begin();
+		mDirtyRegionTiles.erase(mDirtyRegionTiles.begin());
+
+		auto it = mTiles.find(key);
+
+		if (it == mTiles.end())
+			continue;
+
+		buildRegions(key, *it->second);
+	}
+}
+
+size_t NavMesh::getRegionsCount() const
+{
+	size_t result = 0;
+
+	for (const auto& [key, tile] : mTiles)
+		result += tile->regions.size();
+
+	return result;
+}
+
+void NavMesh::addSingleRegion(Tile& tile, NavArea* area)
+{
+	auto& region = tile.regions.emplace_back();
+	region.seed = area;
+	area->region = &region;
+}
+
+void NavMesh::buildRegions(TileKey key, Tile& tile)
+{
+	// greedy rectangles: the lowest unassigned cell is widened along x,
+	// then rows are added along y while the whole row can join
+
+	for (auto area : tile.areas)
+		area->region = nullptr;
+
+	tile.regions.clear();
+
+	mRegionScratch.assign(tile.areas.begin(), tile.areas.end());
+
+	std::sort(mRegionScratch.begin(), mRegionScratch.end(), [](const NavArea* a, const NavArea* b) {
+		if (a->position.y != b->position.y)
+			return a->position.y < b->position.y;
+
+		if (a->position.x != b->position.x)
+			return a->position.x < b->position.x;
+
+		return a->position.z < b->position.z;
+	});
+
+	auto now = Clock::Now();
+
+	auto can_join = [&](const NavArea* area) {
+		return area != nullptr && area->region == nullptr && GetTileKey(area->position) == key && isMergeable(area, now);
+	};
+
+	std::vector<NavArea*> row;
+	std::vector<NavArea*> next_row;
+
+	for (auto seed : mRegionScratch)
+	{
+		if (seed->region != nullptr)
+			continue;
+
+		addSingleRegion(tile, seed);
+
+		if (!isMergeable(seed, now))
+			continue;
+
+		auto& region = *seed->region;
+
+		row.assign(1, seed);
+
+		while (row.size() < UINT16_MAX)
+		{
+			auto next = row.back()->getNeighbour(NavDirection::Left);
+
+			if (!can_join(next))
+				break;
+
+			next->region = &region;
+			row.push_back(next);
+		}
+
+		region.width = (uint16_t)row.size();
+
+		while (region.height < UINT16_MAX)
+		{
+			next_row.clear();
+
+			for (auto area : row)
+			{
+				auto next = area->getNeighbour(NavDirection::Forward);
+
+				if (!can_join(next))
+					break;
+
+				if (!next_row.empty() && next_row.back()->getNeighbour(NavDirection::Left) != next)
+					break; // another floor
+
+				next_row.push_back(next);
+			}
+
+			if (next_row.size() != row.size())
+				break;
+
+			for (auto area : next_row)
+				area->region = &region;
+
+			region.height += 1;
+			std::swap(row, next_row);
+		}
+	}
+}
+
+bool NavMesh::isMergeable(const NavArea* area, Clock::TimePoint now) const
+{
+	// cells we can walk out of and back into from every side, at no extra cost
+
+	if (mLadderLinks.contains(GetPositionKey(area->position)))
+		return false; // ladder ends stay single, the planner looks their links up by area
+
+	for (auto dir : Directions)
+	{
+		auto link = area->getLink(dir);
+
+		if (link == nullptr || link->traversal != NavTraversal::Walk || link->getPenalty(now) > RegionMaxPenalty)
+			return false;
+
+		auto back_link = link->area->getLink(OppositeDirections.at(dir));
+
+		if (back_link == nullptr || back_link->area != area || back_link->traversal != NavTraversal::Walk || back_link->getPenalty(now) > RegionMaxPenalty)
+			return false;
+	}
+
+	return true;
+}
+
+uint64_t NavMesh::GetPositionKey(const glm::vec3& pos)
+{
+	auto x = (int32_t)glm::round(pos.x);
+	auto y = (int32_t)glm::round(pos.y);
+	auto z = (int32_t)glm::round(pos.z);
+	return ((uint64_t)(uint32_t)x & 0x1fffff) | (((uint64_t)(uint32_t)y & 0x1fffff) << 21) | (((uint64_t)(uint32_t)z & 0x1fffff) << 42);
+}
+
+NavMesh::TileKey NavMesh::GetTileKey(const glm::vec3& pos)
+{
+	auto x = (int32_t)glm::floor(pos.x / TileSize);
+	auto y = (int32_t)glm::floor(pos.y / TileSize);
+	return ((uint64_t)(uint32_t)x << 32) | (uint64_t)(uint32_t)y;
+}
+
+NavMesh::Tile& NavMesh::getTile(TileKey key)
+{
+	auto& tile = mTiles[key];
+
+	if (tile == nullptr)
+		tile = std::make_unique<Tile>();
+
+	return *tile;
+}
+
+const NavMesh::Tile* NavMesh::findTile(TileKey key) const
+{
+	auto it = mTiles.find(key);
+
+	if (it == mTiles.end())
+		return nullptr;
+
+	return it->second.get();
+}
+
+glm::vec3 NavMesh::getLinkTarget(const NavArea* area, NavDirection dir, const NavLink& link) const
+{
+	auto pos = area->position;
+
+	if (dir == NavDirection::Back)
+		pos.y -= mStep;
+	else if (dir == NavDirection::Forward)
+		pos.y += mStep;
+	else if (dir == NavDirection::Left)
+		pos.x += mStep;
+	else if (dir == NavDirection::Right)
+		pos.x -= mStep;
+
+	pos.z += link.height_delta;
+	return pos;
+}
+
+std::vector<uint8_t> NavMesh::encodeTile(TileKey key, const Tile& tile) const
+{
+	NavTileFormat::Header header;
+	header.magic = NavTileFormat::Magic;
+	header.version = NavTileFormat::Version;
+	header.tile_x = (int32_t)(key >> 32);
+	header.tile_y = (int32_t)(key & 0xFFFFFFFF);
+	header.area_count = (uint32_t)tile.areas.size();
+
+	std::vector<uint8_t> result(sizeof(header) + sizeof(NavTileFormat::Area) * tile.areas.size());
+	std::memcpy(result.data(), &header, sizeof(header));
+
+	auto records = result.data() + sizeof(header);
+	auto now = Clock::Now();
+
+	for (size_t i = 0; i < tile.areas.size(); i++)
+	{
+		auto area = tile.areas[i];
+
+		NavTileFormat::Area record;
+		record.x = area->position.x;
+		record.y = area->position.y;
+		record.z = area->position.z;
+		record.component_node = area->component_node;
+
+		for (size_t j = 0; j < area->neighbours.size(); j++)
+		{
+			const auto& neighbour = area->neighbours[j];
+			auto& link = record.links[j];
+			link = {};
+
+			if (!neighbour.has_value())
+			{
+				link.state = (uint8_t)NavTileFormat::LinkState::Unprobed;
+				continue;
+			}
+
+			if (neighbour->area == nullptr && !neighbour->paged_out)
+			{
+				link.state = (uint8_t)NavTileFormat::LinkState::Blocked;
+				continue;
+			}
+
+			link.state = (uint8_t)NavTileFormat::LinkState::Linked;
+			link.traversal = (uint8_t)neighbour->traversal;
+			link.height_delta = (int16_t)glm::round(neighbour->height_delta * NavTileFormat::HeightScale);
+			link.clearance = (uint16_t)glm::clamp(glm::round(neighbour->clearance * NavTileFormat::HeightScale), 0.0f, 65535.0f);
+			link.penalty = neighbour->getPenalty(now);
+		}
+
+		std::memcpy(records + i * sizeof(record), &record, sizeof(record));
+	}
+
+	return result;
+}
+
+bool NavMesh::decodeTile(TileKey key, const std::vector<uint8_t>& data)
+{
+	NavTileFormat::Header header;
+
+	if (data.size() < sizeof(header))
+		return false;
+
+	std::memcpy(&header, data.data(), sizeof(header));
+
+	if (header.magic != NavTileFormat::Magic || header.version != NavTileFormat::Version)
+		return false;
+
+	if (data.size() < sizeof(header) + sizeof(NavTileFormat::Area) * header.area_count)
+		return false;
+
+	auto& tile = getTile(key);
+	tile.last_used_time = Clock::Now();
+
+	std::pmr::polymorphic_allocator<NavArea> allocator(&tile.arena);
+	auto records = data.data() + sizeof(header);
+
+	for (uint32_t i = 0; i < header.area_count; i++)
+	{
+		NavTileFormat::Area record;
+		std::memcpy(&record, records + i * sizeof(record), sizeof(record));
+
+		auto area = allocator.new_object<NavArea>();
+		area->position = { record.x, record.y, record.z };
+		area->component_node = record.component_node;
+
+		for (size_t j = 0; j < area->neighbours.size(); j++)
+		{
+			const auto& link = record.links[j];
+			auto state = (NavTileFormat::LinkState)link.state;
+
+			if (state == NavTileFormat::LinkState::Unprobed)
+				continue;
+
+			NavLink neighbour;
+
+			if (state == NavTileFormat::LinkState::Linked)
+			{
+				neighbour.traversal = (NavTraversal)link.traversal;
+				neighbour.height_delta = link.height_delta / NavTileFormat::HeightScale;
+				neighbour.clearance = link.clearance / NavTileFormat::HeightScale;
+				neighbour.penalty = link.penalty;
+				neighbour.penalty_time = tile.last_used_time;
+				neighbour.paged_out = true; // resolved below
+			}
+
+			area->neighbours[j] = neighbour;
+		}
+
+		tile.areas.push_back(area);
+		addSingleRegion(tile, area);
+	}
+
+	markTileChanged(key);
+
+	// links of this tile and of the resident tiles around it, that point into each other.
+	// targets are looked up by their grid column in the target tile, not by scanning it
+
+	auto get_column_key = [&](const glm::vec3& pos) {
+		auto x = (int32_t)glm::round(pos.x / mStep);
+		auto y = (int32_t)glm::round(pos.y / mStep);
+		return ((uint64_t)(uint32_t)x << 32) | (uint64_t)(uint32_t)y;
+	};
+
+	std::unordered_map<TileKey, std::unordered_multimap<uint64_t, NavArea*>> columns;
+
+	auto find_target = [&](const glm::vec3& target) -> NavArea* {
+		auto target_key = GetTileKey(target);
+		auto target_columns = columns.find(target_key);
+
+		if (target_columns == columns.end())
+		{
+			auto target_tile = findTile(target_key);
+
+			if (target_tile == nullptr)
+				return nullptr;
+
+			target_columns = columns.insert({ target_key, {} }).first;
+
+			for (auto area : target_tile->areas)
+				target_columns->second.insert({ get_column_key(area->position), area });
+		}
+
+		auto [begin, end] = target_columns->second.equal_range(get_column_key(target));
+
+		for (auto it = begin; it != end; ++it)
+		{
+			if (glm::distance(it->second->position, target) <= mStep * 0.25f)
+				return it->second;
+		}
+
+		return nullptr;
+	};
+
+	auto resolve = [&](NavArea* area, std::optional<TileKey> target_key) {
+		for (auto dir : Directions)
+		{
+			auto& neighbour = area->neighbours[static_cast<size_t>(dir)];
+
+			if (!neighbour.has_value() || !neighbour->paged_out)
+				continue;
+
+			auto target = getLinkTarget(area, dir, neighbour.value());
+
+			if (target_key.has_value() && GetTileKey(target) != target_key.value())
+				continue;
+
+			auto target_area = find_target(target);
+
+			if (target_area == nullptr)
+				continue;
+
+			neighbour->area = target_area;
+			neighbour->paged_out = false;
+		}
+	};
+
+	for (auto area : tile.areas)
+		resolve(area, std::nullopt);
+
+	forEachTileKey(GetTileCenter(key), TileSize, [&](TileKey neighbour_key) {
+		if (neighbour_key == key)
+			return;
+
+		auto neighbour_tile = findTile(neighbour_key);
+
+		if (neighbour_tile == nullptr)
+			return;
+
+		for (auto area : neighbour_tile->areas)
+			resolve(area, key);
+	});
+
+	for (auto area : tile.areas)
+	{
+		if (area->isExplored())
+			mExploredAreas.push_back(area);
+		else
+			mUnexploredAreas.push_back(area);
+	}
+
+	return true;
+}
+
+void NavMesh::pageOutTile(TileKey key)
+{
+	auto it = mTiles.find(key);
+
+	if (it == mTiles.end())
+		return;
+
+	auto data = encodeTile(key, *it->second);
+
+	// links from the tiles around into this one have to forget their pointers
+
+	forEachTileKey(GetTileCenter(key), TileSize, [&](TileKey neighbour_key) {
+		if (neighbour_key == key)
+			return;
+
+		auto neighbour_tile = findTile(neighbour_key);
+
+		if (neighbour_tile == nullptr)
+			return;
+
+		for (auto area : neighbour_tile->areas)
+		{
+			for (auto& neighbour : area->neighbours)
+			{
+				if (!neighbour.has_value() || neighbour->area == nullptr)
+					continue;
+
+				if (GetTileKey(neighbour->area->position) != key)
+					continue;
+
+				neighbour->area = nullptr;
+				neighbour->paged_out = true;
+			}
+		}
+	});
+
+	auto in_tile = [&](NavArea* area) {
+		return GetTileKey(area->position) == key;
+	};
+
+	std::erase_if(mExploredAreas, in_tile);
+	std::erase_if(mUnexploredAreas, in_tile);
+
+	mTiles.erase(it);
+	mDirtyRegionTiles.erase(key);
+
+	if (mPageDirectory.has_value())
+	{
+		std::ofstream file(getTilePath(key), std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		file.close(); // flushes, a failed write shows up only here
+
+		if (!file.fail())
+		{
+			mPagedTiles[key] = {};
+			return;
+		}
+
+		std::error_code ec;
+		std::filesystem::remove(getTilePath(key), ec);
+	}
+
+	mPagedTiles[key] = std::move(data);
+}
+
+void NavMesh::pageInTile(TileKey key)
+{
+	auto paged = mPagedTiles.find(key);
+
+	if (paged == mPagedTiles.end())
+		return;
+
+	std::vector<uint8_t> data;
+
+	{
+		std::lock_guard lock(mPrefetchesMutex);
+		auto prefetch = mPrefetches.find(key);
+
+		if (prefetch != mPrefetches.end())
+		{
+			data = prefetch->second.get();
+			mPrefetches.erase(prefetch);
+		}
+	}
+
+	if (data.empty())
+		data = std::move(paged->second);
+
+	if (data.empty() && mPageDirectory.has_value())
+	{
+		std::ifstream file(getTilePath(key), std::ios::binary);
+		data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	// a missing or broken page never decodes, so it is dropped either way, but only after decoding,
+	// when it fails the areas around forget their links into it and the tile is built again
+
+	auto decoded = decodeTile(key, data);
+
+	mPagedTiles.erase(key);
+
+	if (mPageDirectory.has_value())
+	{
+		std::error_code ec;
+		std::filesystem::remove(getTilePath(key), ec);
+	}
+
+	if (!decoded)
+		forgetLinksInto(key);
+}
+
+void NavMesh::forgetLinksInto(TileKey key)
+{
+	forEachTileKey(GetTileCenter(key), TileSize, [&](TileKey neighbour_key) {
+		if (neighbour_key == key)
+			return;
+
+		auto neighbour_tile = findTile(neighbour_key);
+
+		if (neighbour_tile == nullptr)
+			return;
+
+		bool changed = false;
+
+		for (auto area : neighbour_tile->areas)
+		{
+			auto explored = area->isExplored();
+
+			for (auto dir : Directions)
+			{
+				auto& neighbour = area->neighbours[static_cast<size_t>(dir)];
+
+				if (!neighbour.has_value() || !neighbour->paged_out)
+					continue;
+
+				if (GetTileKey(getLinkTarget(area, dir, neighbour.value())) != key)
+					continue;
+
+				neighbour.reset(); // unprobed, the builder probes it again
+				changed = true;
+			}
+
+			if (explored && !area->isExplored())
+			{
+				std::erase(mExploredAreas, area);
+				mUnexploredAreas.push_back(area);
+			}
+		}
+
+		if (changed)
+			markTileChanged(neighbour_key);
+	});
+}
+
+std::filesystem::path NavMesh::getTilePath(TileKey key) const
+{
+	auto x = (int32_t)(key >> 32);
+	auto y = (int32_t)(key & 0xFFFFFFFF);
+	return mPageDirectory.value() / (std::to_string(x) + "_" + std::to_string(y) + NavTileFormat::Extension);
+}
+
+glm::vec3 NavMesh::GetTileCenter(TileKey key)
+{
+	auto x = (int32_t)(key >> 32);
+	auto y = (int32_t)(key & 0xFFFFFFFF);
+	return { (x + 0.5f) * TileSize, (y + 0.5f) * TileSize, 0.0f };
+}
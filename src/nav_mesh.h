@@ -0,0 +1,273 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <array>
+#include <map>
+#include <vector>
+#include <optional>
+#include <memory_resource>
+#include <span>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <common/clock.h>
+
+enum class NavDirection
+{
+	Forward,
+	Back,
+	Left,
+	Right
+};
+
+enum class NavTraversal
+{
+	Walk,
+	Step,
+	Jump,
+	CrouchJump,
+	DuckOnly,
+	Drop,
+	Ladder
+};
+
+struct NavArea;
+
+struct NavLink
+{
+	NavArea* area = nullptr; // nullptr when there is no way in this direction
+	NavTraversal traversal = NavTraversal::Walk;
+	float height_delta = 0.0f; // destination ground z minus source ground z
+	float clearance = 0.0f; // free height above destination ground
+	bool paged_out = false; // destination tile is not resident, area is nullptr until it is loaded back
+	float penalty = 0.0f; // extra path cost learned from failed traversals, as of penalty_time
+	Clock::TimePoint penalty_time;
+
+	static constexpr float PenaltyHalfLifeSeconds = 30.0f;
+
+	float getPenalty(Clock::TimePoint now) const;
+};
+
+struct NavRegion;
+
+struct NavArea
+{
+	glm::vec3 position = { 0.0f, 0.0f, 0.0f };
+	std::array<std::optional<NavLink>, 4> neighbours; // indexed by NavDirection, nullopt until probed
+	uint32_t component_node = 0; // index in the component table of the mesh
+	NavRegion* region = nullptr; // every resident area has one
+	bool isExplored() const;
+	bool isBorder() const;
+	bool isNeighbour(const NavArea* area) const;
+	bool isProbed(NavDirection dir) const;
+	NavArea* getNeighbour(NavDirection dir) const;
+	const NavLink* getLink(NavDirection dir) const;
+	const NavLink* findLink(const NavArea* area) const;
+	void setNeighbour(NavDirection dir, const NavLink& link);
+	void addLinkPenalty(NavDirection dir, float penalty, Clock::TimePoint now);
+};
+
+// rectangle of grid cells with walk links between all of them, a straight line inside it is always walkable
+struct NavRegion
+{
+	NavArea* seed = nullptr; // corner with the lowest x and y, the other cells follow by Left and Forward links
+	uint16_t width = 1; // cells along x
+	uint16_t height = 1; // cells along y
+
+	size_t getAreasCount() const { return (size_t)width * height; }
+
+	template <typename F> void forEachBorderArea(F&& func) const;
+};
+
+// areas are grouped into fixed size spatial tiles, every tile has its own arena.
+// raw NavArea pointers stay valid until clear() or until their tile is paged out by evictTiles().
+// a paged out tile is kept in a compact form (on disk when a page directory is set) and is
+// loaded back by requireTiles() or, asynchronously, by prefetchTiles() + integratePrefetchedTiles()
+
+class NavMesh
+{
+public:
+	using AreaList = std::pmr::vector<NavArea*>;
+	using TileKey = uint64_t;
+
+	static constexpr float TileSize = 1024.0f;
+
+public:
+	NavMesh();
+	~NavMesh();
+	NavMesh(const NavMesh&) = delete;
+	NavMesh& operator=(const NavMesh&) = delete;
+
+public:
+	NavArea* createArea(const glm::vec3& position);
+	void collectExploredAreas();
+	void clear();
+
+	NavArea* findExactArea(const glm::vec3& pos, float tolerance) const; // resident tiles only
+
+	// connected components over two-way links, kept up to date as links are added,
+	// so queries between areas that can never reach each other fail right away
+	void connectAreas(NavArea* a, NavArea* b);
+	uint32_t getComponent(const NavArea* area) const;
+	bool isReachable(const NavArea* a, const NavArea* b) const;
+
+	// ladders join areas that are not grid neighbours, both ends are kept by position, so they survive paging
+	void addLadderLink(NavArea* a, NavArea* b);
+	std::optional<glm::vec3> getLadderTarget(const NavArea* area) const;
+	NavArea* findLadderNeighbour(const NavArea* area) const; // resident tiles only
+	size_t getLadderLinksCount() const { return mLadderLinks.size() / 2; }
+	bool isLaddersLinked() const { return mLaddersLinked; }
+	void setLaddersLinked(bool value) { mLaddersLinked = value; }
+
+	// flat fully linked cells of a tile are merged into rectangles, planning runs over them.
+	// new areas start as single cell regions, changed tiles are merged again by updateRegions().
+	// cells with penalized links stay single, so the planner sees their penalties at region borders
+	static constexpr float RegionMaxPenalty = 1.0f;
+
+	void updateRegions(size_t max_tiles);
+	size_t getRegionsCount() const;
+	size_t getDirtyRegionTilesCount() const { return mDirtyRegionTiles.size(); }
+
+	// a tile version goes up whenever the tile gains areas, links or blocked probes, or is paged in, see FlowField
+	const auto& getTileVersions() const { return mTileVersions; }
+	std::span<NavArea* const> getTileAreas(TileKey key) const; // resident tiles only
+	void markAreaProbed(const NavArea* area) { mTileVersions[GetTileKey(area->position)] += 1; } // blocked probe, regions do not change
+	uint32_t getPenaltiesVersion() const { return mPenaltiesVersion; }
+	void markPenaltiesChanged(const NavArea* area, const NavArea* neighbour); // of the link between them
+
+public:
+	const auto& getExploredAreas() const { return mExploredAreas; }
+	const auto& getUnexploredAreas() const { return mUnexploredAreas; }
+
+public:
+	static constexpr float DefaultStep = 32.0f;
+
+	void setStep(float value) { mStep = value; } // of an empty mesh only, areas are on the grid of this step
+	float getStep() const { return mStep; }
+	void setPageDirectory(const std::filesystem::path& path);
+	void requireTiles(const glm::vec3& pos, float radius); // marks as used, loads paged out tiles right now
+	void prefetchTiles(const glm::vec3& pos, float radius); // starts reading paged out tiles in background
+	void integratePrefetchedTiles();
+	void evictTiles(size_t max_resident_bytes, Clock::Duration min_idle); // 0 bytes is unlimited
+	void evictIdleTiles(Clock::Duration min_idle); // every tile idle for that long, whatever the budget
+
+	size_t getResidentBytes() const;
+	size_t getResidentTilesCount() const { return mTiles.size(); }
+	size_t getPagedTilesCount() const { return mPagedTiles.size(); }
+
+public:
+	static NavArea* FindNearestArea(std::span<NavArea* const> areas, const glm::vec3& pos);
+	static NavArea* FindExactArea(std::span<NavArea* const> areas, const glm::vec3& pos, float tolerance);
+	static TileKey GetTileKey(const glm::vec3& pos);
+	static glm::vec3 GetTileCenter(TileKey key);
+	static uint64_t GetPositionKey(const glm::vec3& pos); // stable across paging
+
+private:
+	struct Tile
+	{
+		std::pmr::monotonic_buffer_resource arena;
+		std::vector<NavArea*> areas;
+		std::deque<NavRegion> regions; // deque, areas point into it
+		Clock::TimePoint last_used_time = Clock::Now();
+	};
+
+	Tile& getTile(TileKey key);
+	const Tile* findTile(TileKey key) const;
+	glm::vec3 getLinkTarget(const NavArea* area, NavDirection dir, const NavLink& link) const;
+	std::vector<uint8_t> encodeTile(TileKey key, const Tile& tile) const;
+	bool decodeTile(TileKey key, const std::vector<uint8_t>& data); // false on bad data, nothing is changed then
+	void pageOutTile(TileKey key);
+	void pageInTile(TileKey key);
+	void forgetLinksInto(TileKey key); // of a tile that could not be paged in, so it is probed and built again
+	void addSingleRegion(Tile& tile, NavArea* area);
+	void buildRegions(TileKey key, Tile& tile);
+	bool isMergeable(const NavArea* area, Clock::TimePoint now) const;
+	void markTileChanged(TileKey key);
+	uint32_t findComponentRoot(uint32_t node);
+	void unionComponents(uint32_t node_a, uint32_t node_b);
+	void flattenComponents();
+	std::filesystem::path getTilePath(TileKey key) const;
+	template <typename F> void forEachTileKey(const glm::vec3& pos, float radius, F&& func) const;
+
+private:
+	std::pmr::monotonic_buffer_resource mArena;
+	AreaList mExploredAreas;
+	AreaList mUnexploredAreas;
+	std::unordered_map<TileKey, std::unique_ptr<Tile>> mTiles;
+	std::unordered_map<TileKey, std::vector<uint8_t>> mPagedTiles; // compact data, or empty when it lives on disk
+	std::unordered_map<TileKey, std::future<std::vector<uint8_t>>> mPrefetches;
+	mutable std::mutex mPrefetchesMutex; // prefetchTiles() is called by planners that only hold a shared lock
+	std::optional<std::filesystem::path> mPageDirectory;
+	std::vector<uint32_t> mComponentParents; // union-find by component_node, survives paging
+	std::vector<uint8_t> mComponentRanks;
+	bool mComponentsFlattened = true;
+	std::unordered_map<uint64_t, glm::vec3> mLadderLinks; // by position key of one end, the other end
+	bool mLaddersLinked = false;
+	std::unordered_set<TileKey> mDirtyRegionTiles;
+	std::vector<NavArea*> mRegionScratch;
+	std::unordered_map<TileKey, uint32_t> mTileVersions;
+	uint32_t mPenaltiesVersion = 0;
+	float mStep = DefaultStep;
+};
+
+struct NavWaypoint
+{
+	glm::vec3 position = { 0.0f, 0.0f, 0.0f };
+	NavTraversal traversal = NavTraversal::Walk; // how to get here from the previous waypoint
+};
+
+using NavChain = std::vector<NavWaypoint>; // string-pulled waypoints, the next one is at back()
+
+const std::vector<NavDirection> Directions = {
+	NavDirection::Forward,
+	NavDirection::Left,
+	NavDirection::Right,
+	NavDirection::Back,
+};
+
+const std::map<NavDirection, NavDirection> OppositeDirections = {
+	{ NavDirection::Forward, NavDirection::Back },
+	{ NavDirection::Back, NavDirection::Forward },
+	{ NavDirection::Left, NavDirection::Right },
+	{ NavDirection::Right, NavDirection::Left },
+};
+
+template <typename F> void NavRegion::forEachBorderArea(F&& func) const
+{
+	// walks the perimeter only, the left and right columns go up together
+
+	auto walk_row = [&](NavArea* area) {
+		for (uint16_t x = 0; x < width; x++)
+		{
+			func(area);
+
+			if (x + 1 < width)
+				area = area->getNeighbour(NavDirection::Left);
+		}
+		return area;
+	};
+
+	auto left = seed;
+	auto right = walk_row(seed);
+
+	for (uint16_t y = 1; y < height; y++)
+	{
+		left = left->getNeighbour(NavDirection::Forward);
+		right = right->getNeighbour(NavDirection::Forward);
+
+		if (y == height - 1)
+		{
+			walk_row(left);
+			break;
+		}
+
+		func(left);
+
+		if (right != left)
+			func(right);
+	}
+}
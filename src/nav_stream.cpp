@@ -0,0 +1,285 @@
+#include "nav_stream.h"
+#include "local_socket.h"
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+
+namespace
+{
+	uint8_t GetLinkState(const std::optional<NavLink>& link)
+	{
+		if (!link.has_value())
+			return NavStreamFormat::Unprobed;
+
+		if (link->paged_out)
+			return NavStreamFormat::PagedOut;
+
+		if (link->area == nullptr)
+			return NavStreamFormat::Blocked;
+
+		return NavStreamFormat::Linked + static_cast<uint8_t>(link->traversal);
+	}
+}
+
+NavStream::NavStream() :
+	mListenSocket(LocalSocket::Invalid)
+{
+}
+
+NavStream::~NavStream()
+{
+	close();
+}
+
+bool NavStream::listen(uint16_t port)
+{
+	close();
+
+	if (port == 0)
+		return true;
+
+	auto socket = LocalSocket::Listen(port, (int)MaxViewers);
+
+	if (socket == LocalSocket::Invalid)
+		return false;
+
+	mListenSocket = socket;
+	mPort = port;
+	return true;
+}
+
+void NavStream::close()
+{
+	for (auto& viewer : mViewers)
+		closeViewer(viewer);
+
+	mViewers.clear();
+
+	if (mListenSocket != LocalSocket::Invalid)
+		LocalSocket::Close(mListenSocket);
+
+	mListenSocket = LocalSocket::Invalid;
+	mPort = 0;
+	mMesh = nullptr;
+	mChain.clear();
+}
+
+void NavStream::reset()
+{
+	for (auto& viewer : mViewers)
+	{
+		viewer.tile_versions.clear();
+		viewer.need_clear = true;
+		viewer.need_chain = true;
+	}
+}
+
+void NavStream::update(const NavMesh& mesh, const NavChain& chain, const NavStreamFormat::Tick& tick)
+{
+	if (mListenSocket == LocalSocket::Invalid)
+		return;
+
+	acceptViewers();
+
+	if (mViewers.empty())
+		return;
+
+	if (&mesh != mMesh)
+	{
+		reset();
+		mMesh = &mesh;
+	}
+
+	bool chain_changed = !std::equal(chain.begin(), chain.end(), mChain.begin(), mChain.end(), [](const NavWaypoint& a, const NavWaypoint& b) {
+		return a.position == b.position && a.traversal == b.traversal;
+	});
+
+	if (chain_changed)
+		mChain = chain;
+
+	glm::vec3 origin = { tick.record.origin[0], tick.record.origin[1], tick.record.origin[2] };
+
+	for (auto& viewer : mViewers)
+	{
+		if (viewer.need_hello)
+		{
+			NavStreamFormat::Hello hello;
+			hello.magic = NavStreamFormat::Magic;
+			hello.version = NavStreamFormat::Version;
+			hello.nav_step = mesh.getStep();
+			Append(viewer.pending, NavStreamFormat::MessageType::Hello, &hello, sizeof(hello));
+			viewer.need_hello = false;
+		}
+
+		if (viewer.need_clear)
+		{
+			Append(viewer.pending, NavStreamFormat::MessageType::Clear, nullptr, 0);
+			viewer.need_clear = false;
+		}
+
+		// changed tiles nearest to the bot first, as many as the batch takes
+
+		std::vector<std::pair<float, NavMesh::TileKey>> changed_tiles;
+
+		for (const auto& [key, version] : mesh.getTileVersions())
+		{
+			auto it = viewer.tile_versions.find(key);
+
+			if (it != viewer.tile_versions.end() && it->second == version)
+				continue;
+
+			changed_tiles.push_back({ glm::distance(NavMesh::GetTileCenter(key), origin), key });
+		}
+
+		std::sort(changed_tiles.begin(), changed_tiles.end());
+
+		for (auto [distance, key] : changed_tiles)
+		{
+			if (viewer.pending.size() >= MaxBatchBytes)
+				break; // the viewer is behind, the rest waits
+
+			auto areas = mesh.getTileAreas(key);
+
+			if (areas.empty())
+				continue; // paged out, the viewer keeps what it has
+
+			auto version = mesh.getTileVersions().at(key);
+			AppendTile(viewer.pending, key, version, areas);
+			viewer.tile_versions[key] = version;
+		}
+
+		if (chain_changed || viewer.need_chain)
+		{
+			AppendChain(viewer.pending, mChain);
+			viewer.need_chain = false;
+		}
+
+		Append(viewer.pending, NavStreamFormat::MessageType::Tick, &tick, sizeof(tick));
+	}
+
+	std::erase_if(mViewers, [&](Viewer& viewer) {
+		if (flush(viewer) && viewer.pending.size() <= MaxPendingBytes)
+			return false;
+
+		closeViewer(viewer);
+		return true;
+	});
+}
+
+void NavStream::acceptViewers()
+{
+	while (true)
+	{
+		auto socket = LocalSocket::Accept(mListenSocket);
+
+		if (socket == LocalSocket::Invalid)
+			break;
+
+		if (mViewers.size() >= MaxViewers)
+		{
+			LocalSocket::Close(socket);
+			continue;
+		}
+
+		Viewer viewer;
+		viewer.socket = socket;
+		mViewers.push_back(std::move(viewer));
+	}
+}
+
+bool NavStream::flush(Viewer& viewer)
+{
+	size_t sent = 0;
+
+	while (sent < viewer.pending.size())
+	{
+		auto size = (int)std::min<size_t>(viewer.pending.size() - sent, MaxBatchBytes);
+		auto result = LocalSocket::Send(viewer.socket, viewer.pending.data() + sent, size);
+
+		if (result < 0)
+			return false;
+
+		if (result == 0)
+			break; // socket buffer is full, the rest goes next time
+
+		sent += (size_t)result;
+	}
+
+	viewer.pending.erase(viewer.pending.begin(), viewer.pending.begin() + sent);
+	return true;
+}
+
+void NavStream::closeViewer(Viewer& viewer)
+{
+	if (viewer.socket != LocalSocket::Invalid)
+		LocalSocket::Close(viewer.socket);
+
+	viewer.socket = LocalSocket::Invalid;
+}
+
+void NavStream::Append(std::vector<uint8_t>& buffer, NavStreamFormat::MessageType type, const void* data, size_t size)
+{
+	NavStreamFormat::MessageHeader header;
+	header.type = static_cast<uint8_t>(type);
+	header.size = (uint32_t)size;
+
+	auto header_bytes = reinterpret_cast<const uint8_t*>(&header);
+	buffer.insert(buffer.end(), header_bytes, header_bytes + sizeof(header));
+
+	if (size == 0)
+		return;
+
+	auto bytes = reinterpret_cast<const uint8_t*>(data);
+	buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+void NavStream::AppendTile(std::vector<uint8_t>& buffer, NavMesh::TileKey key, uint32_t version, std::span<NavArea* const> areas)
+{
+	NavStreamFormat::TileHeader tile;
+	tile.key = key;
+	tile.version = version;
+	tile.area_count = (uint32_t)areas.size();
+
+	auto offset = buffer.size();
+	Append(buffer, NavStreamFormat::MessageType::Tile, &tile, sizeof(tile));
+
+	for (auto area : areas)
+	{
+		NavStreamFormat::Area record;
+		record.position[0] = area->position.x;
+		record.position[1] = area->position.y;
+		record.position[2] = area->position.z;
+
+		for (auto dir : Directions)
+			record.links[static_cast<size_t>(dir)] = GetLinkState(area->neighbours[static_cast<size_t>(dir)]);
+
+		auto bytes = reinterpret_cast<const uint8_t*>(&record);
+		buffer.insert(buffer.end(), bytes, bytes + sizeof(record));
+	}
+
+	// the header went out before the areas, fix up its size
+	uint32_t size = (uint32_t)(buffer.size() - offset - sizeof(NavStreamFormat::MessageHeader));
+	std::memcpy(buffer.data() + offset + offsetof(NavStreamFormat::MessageHeader, size), &size, sizeof(size));
+}
+
+void NavStream::AppendChain(std::vector<uint8_t>& buffer, const NavChain& chain)
+{
+	auto offset = buffer.size();
+	uint32_t count = (uint32_t)chain.size();
+	Append(buffer, NavStreamFormat::MessageType::Chain, &count, sizeof(count));
+
+	for (const auto& waypoint : chain)
+	{
+		NavStreamFormat::Waypoint record;
+		record.position[0] = waypoint.position.x;
+		record.position[1] = waypoint.position.y;
+		record.position[2] = waypoint.position.z;
+		record.traversal = static_cast<uint8_t>(waypoint.traversal);
+
+		auto bytes = reinterpret_cast<const uint8_t*>(&record);
+		buffer.insert(buffer.end(), bytes, bytes + sizeof(record));
+	}
+
+	uint32_t size = (uint32_t)(buffer.size() - offset - sizeof(NavStreamFormat::MessageHeader));
+	std::memcpy(buffer.data() + offset + offsetof(NavStreamFormat::MessageHeader, size), &size, sizeof(size));
+}
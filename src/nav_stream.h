@@ -0,0 +1,63 @@
+#pragma once
+
+#include "nav_mesh.h"
+#include "nav_stream_format.h"
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+// streams nav mesh changes, the nav chain and think tick stats to external viewers (tools/nav_viewer) over loopback tcp.
+// sockets never block, what does not fit into a flush waits for the next one, so bots pay for encoding only.
+// the owner serializes every call and holds at least the shared nav lock around update()
+
+class NavStream
+{
+public:
+	static constexpr size_t MaxViewers = 4;
+	static constexpr size_t MaxBatchBytes = 64 * 1024; // of tiles per viewer and flush
+	static constexpr size_t MaxPendingBytes = 1024 * 1024; // unsent data of a viewer that stopped reading, then we drop it
+
+public:
+	NavStream();
+	~NavStream();
+
+	NavStream(const NavStream&) = delete;
+	NavStream& operator=(const NavStream&) = delete;
+
+	bool listen(uint16_t port); // 0 closes
+	void close();
+	void reset(); // the mesh was cleared, viewers start over
+
+	void update(const NavMesh& mesh, const NavChain& chain, const NavStreamFormat::Tick& tick);
+
+	auto getPort() const { return mPort; }
+	size_t getViewersCount() const { return mViewers.size(); }
+
+private:
+	using Socket = intptr_t;
+
+	struct Viewer
+	{
+		Socket socket;
+		std::unordered_map<NavMesh::TileKey, uint32_t> tile_versions; // as sent
+		std::vector<uint8_t> pending;
+		bool need_hello = true;
+		bool need_clear = false;
+		bool need_chain = true;
+	};
+
+	void acceptViewers();
+	bool flush(Viewer& viewer); // false when the viewer is gone
+	void closeViewer(Viewer& viewer);
+
+	static void Append(std::vector<uint8_t>& buffer, NavStreamFormat::MessageType type, const void* data, size_t size);
+	static void AppendTile(std::vector<uint8_t>& buffer, NavMesh::TileKey key, uint32_t version, std::span<NavArea* const> areas);
+	static void AppendChain(std::vector<uint8_t>& buffer, const NavChain& chain);
+
+private:
+	Socket mListenSocket;
+	uint16_t mPort = 0;
+	std::vector<Viewer> mViewers;
+	const NavMesh* mMesh = nullptr; // the one viewers have seen, another one means a new map
+	NavChain mChain; // as sent
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "flight_record_format.h"
+#include <cstdint>
+
+// nav stream wire layout, shared by NavStream and tools/nav_viewer
+//
+// a viewer connects to the loopback port of a bot and reads [MessageHeader][payload] messages,
+// starting with Hello. tiles are sent whole whenever their version changes, the viewer replaces them
+
+namespace NavStreamFormat
+{
+	constexpr uint32_t Magic = 0x534E5658; // "XVNS"
+	constexpr uint32_t Version = 1;
+
+	enum class MessageType : uint8_t
+	{
+		Hello, // Hello
+		Clear, // empty, the mesh was cleared or the map changed, forget every tile
+		Tile, // TileHeader, Area * area_count
+		Chain, // uint32_t count, Waypoint * count, the next waypoint is the last one
+		Tick // Tick
+	};
+
+	enum LinkState : uint8_t
+	{
+		Unprobed,
+		Blocked,
+		PagedOut,
+		Linked // + NavTraversal
+	};
+
+#pragma pack(push, 1)
+	struct MessageHeader
+	{
+		uint8_t type; // MessageType
+		uint32_t size; // of the payload
+	};
+
+	struct Hello
+	{
+		uint32_t magic;
+		uint32_t version;
+		float nav_step;
+	};
+
+	struct TileHeader
+	{
+		uint64_t key;
+		uint32_t version;
+		uint32_t area_count;
+	};
+
+	struct Area
+	{
+		float position[3];
+		uint8_t links[4]; // LinkState by NavDirection
+	};
+
+	struct Waypoint
+	{
+		float position[3];
+		uint8_t traversal; // NavTraversal
+	};
+
+	struct Tick
+	{
+		FlightRecordFormat::Record record; // origin, angles and timings of the last think tick
+		uint32_t explored_areas;
+		uint32_t unexplored_areas;
+		uint32_t resident_tiles;
+		uint32_t paged_tiles;
+		uint32_t stuck_count;
+	};
+#pragma pack(pop)
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+
+// compact paged-out form of one nav mesh tile
+//
+// [Header][Area * area_count]
+//
+// links are stored without pointers, the destination of a link is found again by position
+// (one nav step away in the link direction, height_delta above) when the tile is loaded back
+
+namespace NavTileFormat
+{
+	constexpr uint32_t Magic = 0x544E5658; // "XVNT"
+	constexpr uint32_t Version = 3;
+	constexpr const char* Extension = ".xnt";
+	constexpr float HeightScale = 8.0f; // height_delta and clearance are stored in 1/8 units
+
+	enum class LinkState : uint8_t
+	{
+		Unprobed,
+		Blocked,
+		Linked
+	};
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		int32_t tile_x;
+		int32_t tile_y;
+		uint32_t area_count;
+	};
+
+#pragma pack(push, 1)
+	struct Link
+	{
+		uint8_t state; // LinkState
+		uint8_t traversal; // NavTraversal
+		int16_t height_delta;
+		uint16_t clearance;
+		float penalty; // what was left of it when the tile was paged out
+	};
+
+	struct Area
+	{
+		float x;
+		float y;
+		float z;
+		uint32_t component_node;
+		Link links[4]; // indexed by NavDirection
+	};
+#pragma pack(pop)
+}
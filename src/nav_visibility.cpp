@@ -0,0 +1,139 @@
+#include "nav_visibility.h"
+
+void NavVisibility::addPoint(const glm::vec3& point)
+{
+	auto key = GetClusterKey(point);
+	auto [it, inserted] = mClusterIndices.try_emplace(key, (uint32_t)mClusters.size());
+	auto index = it->second;
+
+	if (inserted)
+		mClusters.emplace_back();
+
+	auto& cluster = mClusters[index];
+
+	if (cluster.samples.size() >= MaxSamples)
+		return;
+
+	// keep the samples spread over the cluster, neighbouring areas would see the same things
+	for (const auto& sample : cluster.samples)
+	{
+		if (glm::distance(sample, point) < ClusterSize * 0.4f)
+			return;
+	}
+
+	cluster.samples.push_back(point);
+	invalidate(index);
+}
+
+void NavVisibility::clear()
+{
+	mClusterIndices.clear();
+	mClusters.clear();
+	mPending.clear();
+}
+
+NavVisibility::Result NavVisibility::query(const glm::vec3& a, const glm::vec3& b) const
+{
+	// close pairs often sit in neighbouring clusters whose samples are far apart, they are traced exactly
+	if (glm::distance(a, b) < ClusterSize)
+		return Result::Partial;
+
+	auto it_a = mClusterIndices.find(GetClusterKey(a));
+	auto it_b = mClusterIndices.find(GetClusterKey(b));
+
+	if (it_a == mClusterIndices.end() || it_b == mClusterIndices.end())
+		return Result::Unknown;
+
+	auto index_a = it_a->second;
+	auto index_b = it_b->second;
+
+	if (index_a == index_b)
+		return Result::Partial; // same cluster, samples say nothing about it
+
+	const auto& cluster = mClusters[index_a];
+
+	if (!GetBit(cluster.known, index_b))
+		return Result::Unknown;
+
+	if (!GetBit(cluster.any_visible, index_b))
+		return Result::Hidden;
+
+	if (GetBit(cluster.all_visible, index_b))
+		return Result::Visible;
+
+	return Result::Partial;
+}
+
+size_t NavVisibility::getBytes() const
+{
+	size_t result = 0;
+
+	for (const auto& cluster : mClusters)
+	{
+		result += cluster.samples.capacity() * sizeof(glm::vec3);
+		result += (cluster.known.capacity() + cluster.any_visible.capacity() + cluster.all_visible.capacity()) * sizeof(uint64_t);
+	}
+
+	return result;
+}
+
+NavVisibility::ClusterKey NavVisibility::GetClusterKey(const glm::vec3& point)
+{
+	auto x = (int32_t)glm::floor(point.x / ClusterSize);
+	auto y = (int32_t)glm::floor(point.y / ClusterSize);
+	auto z = (int32_t)glm::floor(point.z / ClusterHeight);
+	return ((uint64_t)(uint32_t)x & 0x1fffff) | (((uint64_t)(uint32_t)y & 0x1fffff) << 21) | (((uint64_t)(uint32_t)z & 0x1fffff) << 42);
+}
+
+bool NavVisibility::GetBit(const std::vector<uint64_t>& bits, size_t index)
+{
+	auto word = index / 64;
+
+	if (word >= bits.size())
+		return false;
+
+	return (bits[word] >> (index % 64)) & 1;
+}
+
+void NavVisibility::SetBit(std::vector<uint64_t>& bits, size_t index, bool value)
+{
+	auto word = index / 64;
+
+	if (word >= bits.size())
+		bits.resize(word + 1, 0);
+
+	if (value)
+		bits[word] |= 1ull << (index % 64);
+	else
+		bits[word] &= ~(1ull << (index % 64));
+}
+
+void NavVisibility::invalidate(uint32_t index)
+{
+	// a new sample may change the answer for every pair of this cluster
+
+	auto& cluster = mClusters[index];
+	cluster.known.clear();
+	cluster.any_visible.clear();
+	cluster.all_visible.clear();
+
+	for (auto& other : mClusters)
+		SetBit(other.known, index, false);
+
+	if (cluster.pending)
+		return;
+
+	cluster.pending = true;
+	mPending.push_back(index);
+}
+
+void NavVisibility::resolve(uint32_t a, uint32_t b, bool any_visible, bool all_visible)
+{
+	for (auto [from, to] : { std::pair{ a, b }, std::pair{ b, a } })
+	{
+		auto& cluster = mClusters[from];
+		SetBit(cluster.known, to, true);
+		SetBit(cluster.any_visible, to, any_visible);
+		SetBit(cluster.all_visible, to, all_visible);
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// potential visibility between clusters of nav areas, one bit per cluster pair.
+// every cluster keeps a few spread out sample points, a pair is resolved by tracing between all of them,
+// pairs are resolved incrementally within a trace budget, so the table grows together with the mesh.
+// Hidden and Visible answers are approximate (sampled), Partial and Unknown ask the caller to trace.
+// pairs closer than ClusterSize are always Partial, that is where a wrong answer costs the most
+
+class NavVisibility
+{
+public:
+	static constexpr float ClusterSize = 256.0f;
+	static constexpr float ClusterHeight = 128.0f;
+	static constexpr size_t MaxSamples = 4;
+
+	enum class Result
+	{
+		Unknown, // cluster or pair is not resolved yet
+		Hidden, // no sample sees any sample of the other cluster
+		Partial, // some samples see each other
+		Visible // all samples see each other
+	};
+
+public:
+	void addPoint(const glm::vec3& point);
+	void clear();
+
+	// is_visible(const glm::vec3& a, const glm::vec3& b) -> bool, returns the number of traces spent
+	template <typename F> size_t update(F&& is_visible, size_t max_traces);
+
+	Result query(const glm::vec3& a, const glm::vec3& b) const;
+
+	size_t getClustersCount() const { return mClusters.size(); }
+	size_t getPendingCount() const { return mPending.size(); }
+	size_t getBytes() const;
+
+private:
+	using ClusterKey = uint64_t;
+
+	struct Cluster
+	{
+		std::vector<glm::vec3> samples;
+		std::vector<uint64_t> known; // bit per cluster index
+		std::vector<uint64_t> any_visible;
+		std::vector<uint64_t> all_visible;
+		bool pending = false;
+	};
+
+	static ClusterKey GetClusterKey(const glm::vec3& point);
+	static bool GetBit(const std::vector<uint64_t>& bits, size_t index);
+	static void SetBit(std::vector<uint64_t>& bits, size_t index, bool value);
+	void invalidate(uint32_t index);
+	void resolve(uint32_t a, uint32_t b, bool any_visible, bool all_visible);
+
+private:
+	std::unordered_map<ClusterKey, uint32_t> mClusterIndices;
+	std::vector<Cluster> mClusters;
+	std::vector<uint32_t> mPending; // clusters with unresolved pairs
+};
+
+template <typename F> size_t NavVisibility::update(F&& is_visible, size_t max_traces)
+{
+	size_t traces = 0;
+
+	while (!mPending.empty())
+	{
+		auto a = mPending.back();
+
+		for (uint32_t b = 0; b < (uint32_t)mClusters.size(); b++)
+		{
+			if (b == a || GetBit(mClusters[a].known, b))
+				continue;
+
+			const auto& samples_a = mClusters[a].samples;
+			const auto& samples_b = mClusters[b].samples;
+
+			if (traces > 0 && traces + samples_a.size() * samples_b.size() > max_traces)
+				return traces;
+
+			bool any_visible = false;
+			bool all_visible = true;
+
+			for (const auto& sample_a : samples_a)
+			{
+				for (const auto& sample_b : samples_b)
+				{
+					bool visible = is_visible(sample_a, sample_b);
+					any_visible = any_visible || visible;
+					all_visible = all_visible && visible;
+					traces += 1;
+				}
+			}
+
+			resolve(a, b, any_visible, all_visible);
+		}
+
+		mClusters[a].pending = false;
+		mPending.pop_back();
+	}
+
+	return traces;
+}
@@ -0,0 +1,1097 @@
+#include "navigator.h"
+#include <cassert>
+#include <algorithm>
+#include <deque>
+#include <unordered_set>
+#include <unordered_map>
+
+void Navigator::loadBsp(const std::string& path)
+{
+	mBspFile.loadFromFile(path, false);
+	mBspModelIndices.clear();
+
+	if (!mBspHulls.load(path))
+		mBspHulls.clear(); // hull traces fall back to rays
+}
+
+void Navigator::setBsp(BSPFile&& bsp_file, BspHulls&& bsp_hulls)
+{
+	mBspFile = std::move(bsp_file);
+	mBspHulls = std::move(bsp_hulls);
+	mBspModelIndices.clear();
+}
+
+void Navigator::setBspModelOrigin(int model_index, const glm::vec3& origin)
+{
+	mBspFile.setModelOrigin(model_index, origin);
+	mBspHulls.setModelOrigin(model_index, origin);
+}
+
+std::optional<glm::vec3> Navigator::getGroundFromOrigin(const glm::vec3& origin, BspHull hull) const
+{
+	auto start_pos = origin;
+	auto end_pos = start_pos - glm::vec3{ 0.0f, 0.0f, MaxDistance };
+	auto trace = traceHull(start_pos, end_pos, hull);
+
+	if (trace.start_solid)
+		return std::nullopt;
+
+	return trace.endpos - glm::vec3{ 0.0f, 0.0f, getHullHalfHeight(hull) };
+}
+
+std::optional<glm::vec3> Navigator::getRoofFromOrigin(const glm::vec3& origin, BspHull hull) const
+{
+	auto start_pos = origin;
+	auto end_pos = start_pos + glm::vec3{ 0.0f, 0.0f, MaxDistance };
+	auto trace = traceHull(start_pos, end_pos, hull);
+
+	if (trace.start_solid)
+		return std::nullopt;
+
+	return trace.endpos + glm::vec3{ 0.0f, 0.0f, getHullHalfHeight(hull) };
+}
+
+bool Navigator::isVisible(const glm::vec3& eye, const glm::vec3& target) const
+{
+	auto result = traceLine(eye, target);
+	return result.fraction >= 1.0f;
+}
+
+bool Navigator::isInLadder(const glm::vec3& origin, BspHull hull) const
+{
+	const auto half_width = PlayerWidth * 0.5f + 1.0f;
+	const auto half_height = (hull == BspHull::Duck ? PlayerOriginZDuck : PlayerOriginZStand) + 1.0f;
+
+	for (const auto& ladder : mBspHulls.getLadders())
+	{
+		if (origin.x + half_width < ladder.mins.x || origin.x - half_width > ladder.maxs.x)
+			continue;
+
+		if (origin.y + half_width < ladder.mins.y || origin.y - half_width > ladder.maxs.y)
+			continue;
+
+		if (origin.z + half_height < ladder.mins.z || origin.z - half_height > ladder.maxs.z)
+			continue;
+
+		return true;
+	}
+
+	return false;
+}
+
+const BspHulls::Ladder* Navigator::findNearestLadder(const glm::vec3& origin) const
+{
+	const BspHulls::Ladder* result = nullptr;
+	float min_distance = std::numeric_limits<float>::max();
+
+	for (const auto& ladder : mBspHulls.getLadders())
+	{
+		auto closest = glm::clamp(origin, ladder.mins, ladder.maxs);
+		auto distance = glm::distance(origin, closest);
+
+		if (distance >= min_distance)
+			continue;
+
+		result = &ladder;
+		min_distance = distance;
+	}
+
+	return result;
+}
+
+bool Navigator::isVisibleCached(const glm::vec3& eye, const glm::vec3& target) const
+{
+	auto result = mNavMesh->getVisibility().query(eye, target);
+
+	if (result == NavVisibility::Result::Hidden)
+		return false;
+
+	if (result == NavVisibility::Result::Visible)
+		return true;
+
+	return isVisible(eye, target);
+}
+
+size_t Navigator::updateNavVisibility(size_t max_traces)
+{
+	return mNavMesh->getVisibility().update([this](const glm::vec3& a, const glm::vec3& b) {
+		return isVisible(a, b);
+	}, max_traces);
+}
+
+Navigator::TraceResult Navigator::traceLine(const glm::vec3& begin, const glm::vec3& end) const
+{
+	mCounters.traces += 1;
+	auto r = mBspFile.traceLine(begin, end, mBspModelIndices);
+	TraceResult result;
+	result.endpos = r.endpos;
+	result.fraction = r.fraction;
+	result.start_solid = r.startsolid;
+	return result;
+}
+
+Navigator::TraceResult Navigator::traceHull(const glm::vec3& begin, const glm::vec3& end, BspHull hull) const
+{
+	if (hull == BspHull::Point || !mBspHulls.isLoaded())
+		return traceLine(begin, end);
+
+	mCounters.traces += 1;
+	auto r = mBspHulls.trace(begin, end, hull, mBspModelIndices);
+	TraceResult result;
+	result.endpos = r.endpos;
+	result.fraction = r.fraction;
+	result.start_solid = r.start_solid;
+	result.plane_normal = r.plane_normal;
+	return result;
+}
+
+float Navigator::getHullHalfHeight(BspHull hull) const
+{
+	if (!mBspHulls.isLoaded())
+		return 0.0f; // rays
+
+	switch (hull)
+	{
+	case BspHull::Point: return 0.0f;
+	case BspHull::Stand: return 36.0f;
+	case BspHull::Large: return 32.0f;
+	case BspHull::Duck: return 18.0f;
+	}
+	return 0.0f;
+}
+
+Navigator::BuildNavMeshStatus Navigator::buildNavMesh(const glm::vec3& start_ground_point, const glm::vec3& origin, std::optional<Clock::TimePoint> deadline)
+{
+	if (!mNavMesh->isLaddersLinked())
+	{
+		linkLadders();
+		mNavMesh->setLaddersLinked(true);
+	}
+
+	auto base_area = mNavMesh->findExactArea(start_ground_point, mNavMesh->getStep() * 1.25f);
+
+	if (base_area == nullptr)
+	{
+		mNavMesh->createArea(start_ground_point);
+		mNavMesh->getVisibility().addPoint(start_ground_point + glm::vec3{ 0.0f, 0.0f, PlayerOriginZStand });
+		return BuildNavMeshStatus::Processing;
+	}
+
+	std::pmr::monotonic_buffer_resource scratch(mNavScratch.data(), mNavScratch.size());
+	std::pmr::deque<NavArea*> open_list(&scratch);
+	std::pmr::unordered_set<NavArea*> ignore(&scratch);
+	open_list.push_back(base_area);
+	bool skip = false;
+
+	while (!open_list.empty())
+	{
+		auto area = open_list.back();
+		open_list.pop_back();
+
+		if (ignore.contains(area))
+			continue;
+
+		if (deadline.has_value() && Clock::Now() >= deadline.value())
+			return BuildNavMeshStatus::Processing; // out of time, the next call passes the probed areas quickly
+
+		ignore.insert(area);
+		mCounters.expansions += 1;
+
+		while (true)
+		{
+			if (buildNavMesh(area) != BuildNavMeshStatus::Finished)
+				skip = true;
+			else
+				break;
+		}
+
+		if (skip && !deadline.has_value())
+			continue;
+
+		for (auto dir : Directions)
+		{
+			auto neighbour = area->getNeighbour(dir);
+
+			if (neighbour == nullptr)
+				continue;
+
+			if (glm::distance(origin, neighbour->position) > mNavExploreDistance)
+				continue;
+
+			open_list.push_front(neighbour);
+		}
+	}
+
+	if (deadline.has_value())
+		return BuildNavMeshStatus::Finished; // everything in reach is probed
+
+	return skip ? BuildNavMeshStatus::Processing : BuildNavMeshStatus::Finished;
+}
+
+Navigator::BuildNavMeshStatus Navigator::buildNavMesh(NavArea* base_area)
+{
+	auto step = mNavMesh->getStep();
+
+	auto stepPosition = [&](const glm::vec3& pos, NavDirection dir) -> glm::vec3 {
+		auto dst_pos = pos;
+		if (dir == NavDirection::Back)
+			dst_pos.y -= step;
+		else if (dir == NavDirection::Forward)
+			dst_pos.y += step;
+		else if (dir == NavDirection::Left)
+			dst_pos.x += step;
+		else if (dir == NavDirection::Right)
+			dst_pos.x -= step;
+		return dst_pos;
+	};
+
+	for (auto dir : Directions)
+	{
+		if (base_area->isProbed(dir))
+			continue;
+
+		// sweep a ducking player one step ahead at step height, standing room is classified by makeNavLink
+
+		auto src_pos = base_area->position + glm::vec3{ 0.0f, 0.0f, PlayerOriginZDuck + StepHeight };
+		auto dst_pos = stepPosition(src_pos, dir);
+
+		bool over_obstacle = false;
+
+		if (traceHull(src_pos, dst_pos, BspHull::Duck).fraction < 1.0f)
+		{
+			// blocked at step height, maybe we can jump there
+
+			auto jump_src_pos = base_area->position + glm::vec3{ 0.0f, 0.0f, PlayerOriginZDuck + JumpCrouchHeight };
+			auto jump_dst_pos = stepPosition(jump_src_pos, dir);
+
+			if (traceHull(src_pos, jump_src_pos, BspHull::Duck).fraction < 1.0f || traceHull(jump_src_pos, jump_dst_pos, BspHull::Duck).fraction < 1.0f)
+			{
+				base_area->setNeighbour(dir, NavLink{});
+				mNavMesh->markAreaProbed(base_area);
+				return BuildNavMeshStatus::Processing;
+			}
+
+			dst_pos = jump_dst_pos;
+			over_obstacle = true;
+		}
+
+		auto ground = getGroundFromOrigin(dst_pos, BspHull::Duck);
+
+		if (!ground.has_value())
+		{
+			base_area->setNeighbour(dir, NavLink{});
+			mNavMesh->markAreaProbed(base_area);
+			return BuildNavMeshStatus::Processing;
+		}
+
+		auto dst_ground = ground.value();
+
+		mNavMesh->requireTiles(dst_ground, 4.0f); // we may be probing into a paged out tile
+
+		auto neighbour = mNavMesh->findExactArea(dst_ground, 4.0f);
+
+		auto link = makeNavLink(base_area->position, neighbour != nullptr ? neighbour->position : dst_ground, over_obstacle);
+
+		if (!link.has_value())
+		{
+			base_area->setNeighbour(dir, NavLink{});
+			mNavMesh->markAreaProbed(base_area);
+			return BuildNavMeshStatus::Processing;
+		}
+
+		if (neighbour == nullptr)
+		{
+			neighbour = mNavMesh->createArea(dst_ground);
+			mNavMesh->getVisibility().addPoint(dst_ground + glm::vec3{ 0.0f, 0.0f, PlayerOriginZStand }); // where a standing player would see from
+		}
+
+		link->area = neighbour;
+		base_area->setNeighbour(dir, link.value());
+
+		auto back_link = makeNavLink(neighbour->position, base_area->position, over_obstacle);
+
+		if (back_link.has_value())
+			back_link->area = base_area;
+
+		neighbour->setNeighbour(OppositeDirections.at(dir), back_link.value_or(NavLink{}));
+		mNavMesh->connectAreas(base_area, neighbour);
+
+		return BuildNavMeshStatus::Processing;
+	}
+
+	return BuildNavMeshStatus::Finished;
+}
+
+void Navigator::linkLadders()
+{
+	// both ends of every ladder become areas joined by a ladder link, the builder grows the mesh from them as usual
+
+	for (const auto& ladder : mBspHulls.getLadders())
+	{
+		auto center = (ladder.mins + ladder.maxs) * 0.5f;
+		auto size = ladder.maxs - ladder.mins;
+		auto across = size.x < size.y ? glm::vec3{ 1.0f, 0.0f, 0.0f } : glm::vec3{ 0.0f, 1.0f, 0.0f };
+		auto offset = glm::min(size.x, size.y) * 0.5f + PlayerWidth * 0.5f + 1.0f;
+
+		std::optional<glm::vec3> bottom;
+		std::optional<glm::vec3> top;
+
+		for (auto side : { -1.0f, 1.0f })
+		{
+			auto pos = center + (across * offset * side);
+			pos.x = glm::round(pos.x / mNavMesh->getStep()) * mNavMesh->getStep(); // on the grid of the mesh
+			pos.y = glm::round(pos.y / mNavMesh->getStep()) * mNavMesh->getStep();
+
+			auto ground = getGroundFromOrigin({ pos.x, pos.y, ladder.mins.z + PlayerOriginZDuck + StepHeight }, BspHull::Duck);
+
+			if (ground.has_value() && ground.value().z >= ladder.mins.z - JumpHeight && ground.value().z <= ladder.maxs.z - JumpCrouchHeight)
+			{
+				if (!bottom.has_value() || ground.value().z < bottom.value().z)
+					bottom = ground;
+			}
+
+			ground = getGroundFromOrigin({ pos.x, pos.y, ladder.maxs.z + PlayerOriginZDuck + 1.0f }, BspHull::Duck);
+
+			if (ground.has_value() && ground.value().z >= ladder.maxs.z - PlayerHeightStand)
+			{
+				if (!top.has_value() || ground.value().z > top.value().z)
+					top = ground;
+			}
+		}
+
+		if (!bottom.has_value() || !top.has_value())
+			continue;
+
+		if (top.value().z - bottom.value().z <= JumpCrouchHeight)
+			continue; // we can jump there, the builder will find it
+
+		auto get_area = [&](const glm::vec3& ground) {
+			mNavMesh->requireTiles(ground, 4.0f);
+
+			auto area = mNavMesh->findExactArea(ground, 4.0f);
+
+			if (area == nullptr)
+			{
+				area = mNavMesh->createArea(ground);
+				mNavMesh->getVisibility().addPoint(ground + glm::vec3{ 0.0f, 0.0f, PlayerOriginZStand });
+			}
+
+			return area;
+		};
+
+		mNavMesh->addLadderLink(get_area(bottom.value()), get_area(top.value()));
+	}
+}
+
+std::optional<NavLink> Navigator::makeNavLink(const glm::vec3& src_ground, const glm::vec3& dst_ground, bool over_obstacle) const
+{
+	// classifies the move from src to dst, area of the result is left for the caller
+
+	NavLink result;
+	result.height_delta = dst_ground.z - src_ground.z;
+
+	if (result.height_delta > JumpCrouchHeight)
+		return std::nullopt; // we will never get up there
+
+	auto roof = getRoofFromOrigin(dst_ground + glm::vec3{ 0.0f, 0.0f, PlayerOriginZDuck + 1.0f }, BspHull::Duck);
+	result.clearance = roof.has_value() ? roof.value().z - dst_ground.z : 0.0f;
+
+	if (result.clearance < PlayerHeightDuck)
+		return std::nullopt;
+
+	if (result.height_delta > JumpHeight)
+		result.traversal = NavTraversal::CrouchJump;
+	else if (result.height_delta > StepHeight)
+		result.traversal = NavTraversal::Jump;
+	else if (result.height_delta < -StepHeight)
+		result.traversal = NavTraversal::Drop;
+	else if (over_obstacle)
+		result.traversal = NavTraversal::CrouchJump; // something low between us
+	else if (result.clearance < PlayerHeightStand)
+		result.traversal = NavTraversal::DuckOnly;
+	else if (glm::abs(result.height_delta) > 1.0f)
+		result.traversal = NavTraversal::Step;
+	else
+		result.traversal = NavTraversal::Walk;
+
+	return result;
+}
+
+NavChain Navigator::buildNavChain(NavArea* src_area, NavArea* dst_area)
+{
+	assert(src_area);
+	assert(dst_area);
+
+	if (!mNavMesh->isReachable(src_area, dst_area))
+		return { }; // different islands, no need to search
+
+	if (mNavJumpPoints)
+		return buildNavChainOverJumpPoints(src_area, dst_area);
+
+	if (auto chain = buildNavChainOverRegions(src_area, dst_area); chain.has_value())
+		return chain.value();
+
+	return buildNavChainOverJumpPoints(src_area, dst_area);
+}
+
+std::optional<NavChain> Navigator::buildNavChainOverRegions(NavArea* src_area, NavArea* dst_area)
+{
+	// a* over regions, we are searching from dst to src, so parents lead us from src to dst.
+	// a region is entered at one of its border areas (anchor), inside it we walk straight
+
+	struct Info
+	{
+		NavRegion* parent = nullptr;
+		NavArea* anchor = nullptr; // where the path leaves this region towards dst
+		NavArea* via = nullptr; // area of the parent region we step into from anchor
+		float cost_to_start = 0.0f; // g
+		float cost_to_finish = 0.0f; // h
+		auto get_cost_total() const { return cost_to_start + cost_to_finish; } // f
+		//auto get_cost_total() const { return cost_to_start; } // f, dijkstra
+	};
+
+	std::pmr::monotonic_buffer_resource scratch(mNavScratch.data(), mNavScratch.size());
+	std::pmr::unordered_map<NavRegion*, Info> infos(&scratch);
+	std::pmr::unordered_set<NavRegion*> open_list(&scratch);
+	std::pmr::unordered_set<NavRegion*> closed_list(&scratch);
+
+	auto find_best_from_open_list = [&] {
+		float min_cost = std::numeric_limits<float>::max();
+		NavRegion* result = nullptr;
+		for (auto region : open_list)
+		{
+			const auto& info = infos.at(region);
+			auto cost_total = info.get_cost_total();
+			if (cost_total < min_cost)
+			{
+				result = region;
+				min_cost = cost_total;
+			}
+		}
+		assert(result);
+		return result;
+	};
+
+	auto assemble_chain = [&](NavRegion* region) {
+		std::vector<NavArea*> areas;
+		auto push = [&](NavArea* area) {
+			if (areas.empty() || areas.back() != area)
+				areas.push_back(area);
+		};
+		push(src_area);
+		while (region != nullptr)
+		{
+			const auto& info = infos.at(region);
+			push(info.anchor);
+			if (info.via != nullptr)
+				push(info.via);
+			region = info.parent;
+		}
+		return pullNavChain(areas);
+	};
+
+	auto now = Clock::Now();
+	auto step = mNavMesh->getStep();
+
+	// threat is stamped per area, but inside a region we walk straight over many areas,
+	// so every expanded region picks the threatened areas it contains and the walk pays for those it crosses
+
+	using Threats = std::pmr::vector<std::pair<glm::vec3, float>>;
+
+	Threats threats(&scratch);
+	Threats region_threats(&scratch);
+	Threats src_region_threats(&scratch);
+
+	mInfluence.forEachEntry(now, [&](const glm::vec3& position, float value) {
+		threats.push_back({ position, value });
+	});
+
+	auto collect_region_threats = [&](const NavRegion* region, Threats& result) {
+		result.clear();
+
+		auto min = region->seed->position - (step * 0.5f);
+		auto max = region->seed->position + glm::vec3{ (region->width - 0.5f) * step, (region->height - 0.5f) * step, 0.0f };
+
+		for (const auto& [position, value] : threats)
+		{
+			if (position.x < min.x || position.x > max.x || position.y < min.y || position.y > max.y)
+				continue;
+
+			if (glm::abs(position.z - region->seed->position.z) > PlayerHeightDuck)
+				continue; // another floor
+
+			result.push_back({ position, value });
+		}
+	};
+
+	auto get_straight_threat_cost = [&](const Threats& inside, const glm::vec3& from, const glm::vec3& to) {
+		auto a = glm::vec3{ from.x, from.y, 0.0f };
+		auto line = glm::vec3{ to.x - from.x, to.y - from.y, 0.0f };
+		auto length_sq = glm::dot(line, line);
+		float result = 0.0f;
+
+		for (const auto& [position, value] : inside)
+		{
+			auto p = glm::vec3{ position.x, position.y, 0.0f };
+
+			if (glm::distance(p, a) < step * 0.5f)
+				continue; // the area we entered the region at, paid when it was entered
+
+			auto t = length_sq > 0.0f ? glm::clamp(glm::dot(p - a, line) / length_sq, 0.0f, 1.0f) : 0.0f;
+
+			if (glm::distance(p, a + line * t) < step * 0.5f)
+				result += value;
+		}
+
+		return result * NavInfluenceCost;
+	};
+
+	// the walk from src to where the path leaves its region is paid when that region is reached
+	collect_region_threats(src_area->region, src_region_threats);
+
+	if (src_area->region == dst_area->region && get_straight_threat_cost(src_region_threats, src_area->position, dst_area->position) > 0.0f)
+		return std::nullopt; // no way around inside one region, the grid search has one
+
+	auto& dst_region_info = infos[dst_area->region];
+	dst_region_info.anchor = dst_area;
+	dst_region_info.cost_to_finish = glm::distance(dst_area->position, src_area->position);
+	open_list.insert(dst_area->region);
+
+	while (!open_list.empty())
+	{
+		auto region = find_best_from_open_list();
+
+		if (region == src_area->region)
+			return assemble_chain(region);
+
+		open_list.erase(region);
+		closed_list.insert(region);
+		mCounters.expansions += 1;
+
+		const auto anchor = infos.at(region).anchor;
+		const auto anchor_cost = infos.at(region).cost_to_start;
+
+		collect_region_threats(region, region_threats);
+
+		auto try_neighbour = [&](NavArea* area, NavArea* neighbour_nn, NavTraversal traversal, float penalty) {
+			auto neighbour_region = neighbour_nn->region;
+
+			if (neighbour_region == region || closed_list.contains(neighbour_region))
+				return;
+
+			auto cost_multiplier = GetAreaCostMultiplier(neighbour_nn) * GetTraversalCostMultiplier(traversal);
+			auto cost_to_start = anchor_cost + glm::distance(anchor->position, area->position); // straight inside the region
+			cost_to_start += get_straight_threat_cost(region_threats, anchor->position, area->position);
+			cost_to_start += glm::distance(area->position, neighbour_nn->position) * cost_multiplier;
+			cost_to_start += mInfluence.get(neighbour_nn, now) * NavInfluenceCost;
+			cost_to_start += penalty;
+
+			if (neighbour_region == src_area->region)
+				cost_to_start += get_straight_threat_cost(src_region_threats, neighbour_nn->position, src_area->position);
+
+			bool neighbour_is_better = !infos.contains(neighbour_region) || infos.at(neighbour_region).cost_to_start > cost_to_start;
+			
+			if (!neighbour_is_better)
+				return;
+
+			open_list.insert(neighbour_region);
+
+			auto& info = infos[neighbour_region];
+			info.parent = region;
+			info.anchor = neighbour_nn;
+			info.via = area;
+			info.cost_to_finish = glm::distance(neighbour_nn->position, src_area->position);
+			info.cost_to_start = cost_to_start;
+		};
+
+		region->forEachBorderArea([&](NavArea* area) {
+			for (auto dir : Directions)
+			{
+				auto neighbour_nn = area->getNeighbour(dir);
+
+				if (neighbour_nn == nullptr)
+					continue;
+
+				auto link = neighbour_nn->getLink(OppositeDirections.at(dir)); // the way we will actually walk
+
+				if (link == nullptr || link->area != area)
+					continue; // do not allow one-way connections, because we swap src and dst areas
+
+				auto penalty = link->getPenalty(now);
+
+				if (penalty >= NavLinkBlockedPenalty)
+					continue; // we got stuck here again and again lately
+
+				try_neighbour(area, neighbour_nn, link->traversal, penalty);
+			}
+
+			if (auto ladder_neighbour = mNavMesh->findLadderNeighbour(area); ladder_neighbour != nullptr)
+				try_neighbour(area, ladder_neighbour, NavTraversal::Ladder, 0.0f); // ladders go both ways
+		});
+	}
+
+	return { };
+}
+
+NavChain Navigator::buildNavChainOverJumpPoints(NavArea* src_area, NavArea* dst_area)
+{
+	// jump point search on the 4-connected grid, from dst to src like the region search.
+	// jumps run over two-way walk links only and stop at src, at forced neighbours (a side opens where it was closed)
+	// and at special areas (height changes, penalized or ladder links, threat), which are expanded like in plain a*.
+	// horizontal jumps probe both vertical directions at every cell, so kept paths go horizontal first
+
+	struct Info
+	{
+		NavArea* parent = nullptr;
+		std::optional<NavDirection> dir; // of the jump that reached this area
+		float cost_to_start = 0.0f; // g
+		float cost_to_finish = 0.0f; // h
+		auto get_cost_total() const { return cost_to_start + cost_to_finish; } // f
+	};
+
+	std::pmr::monotonic_buffer_resource scratch(mNavScratch.data(), mNavScratch.size());
+	std::pmr::unordered_map<NavArea*, Info> infos(&scratch);
+	std::pmr::unordered_set<NavArea*> open_list(&scratch);
+	std::pmr::unordered_set<NavArea*> closed_list(&scratch);
+
+	auto now = Clock::Now();
+
+	auto get_open_neighbour = [](NavArea* area, NavDirection dir) -> NavArea* {
+		auto link = area->getLink(dir);
+
+		if (link == nullptr || link->traversal != NavTraversal::Walk)
+			return nullptr;
+
+		auto back_link = link->area->getLink(OppositeDirections.at(dir));
+
+		if (back_link == nullptr || back_link->area != area || back_link->traversal != NavTraversal::Walk)
+			return nullptr;
+
+		return link->area;
+	};
+
+	auto is_special = [&](NavArea* area) {
+		for (const auto& neighbour : area->neighbours)
+		{
+			if (!neighbour.has_value() || neighbour->area == nullptr)
+				continue;
+
+			if (neighbour->traversal != NavTraversal::Walk || neighbour->getPenalty(now) > 1.0f)
+				return true;
+		}
+
+		if (mInfluence.get(area, now) > InfluenceMap::MinValue)
+			return true;
+
+		return mNavMesh->getLadderTarget(area).has_value();
+	};
+
+	auto is_vertical = [](NavDirection dir) {
+		return dir == NavDirection::Forward || dir == NavDirection::Back;
+	};
+
+	auto jump = [&](auto& self, NavArea* area, NavDirection dir) -> NavArea* {
+		auto sides = is_vertical(dir) ?
+			std::array{ NavDirection::Left, NavDirection::Right } :
+			std::array{ NavDirection::Forward, NavDirection::Back };
+
+		while (true)
+		{
+			auto next = get_open_neighbour(area, dir);
+
+			if (next == nullptr)
+				return nullptr;
+
+			if (next == src_area || is_special(next))
+				return next;
+
+			for (auto side : sides)
+			{
+				if (get_open_neighbour(next, side) != nullptr && get_open_neighbour(area, side) == nullptr)
+					return next; // forced
+			}
+
+			if (!is_vertical(dir) && (self(self, next, NavDirection::Forward) != nullptr || self(self, next, NavDirection::Back) != nullptr))
+				return next;
+
+			area = next;
+		}
+	};
+
+	auto find_best_from_open_list = [&] {
+		float min_cost = std::numeric_limits<float>::max();
+		NavArea* result = nullptr;
+		for (auto area : open_list)
+		{
+			const auto& info = infos.at(area);
+			auto cost_total = info.get_cost_total();
+			if (cost_total < min_cost)
+			{
+				result = area;
+				min_cost = cost_total;
+			}
+		}
+		assert(result);
+		return result;
+	};
+
+	auto assemble_chain = [&](NavArea* a) {
+		// jump points are joined by straight runs, pullNavChain wants every area on the way
+		std::vector<NavArea*> areas;
+		areas.push_back(a);
+		while (infos.at(a).parent != nullptr)
+		{
+			auto parent = infos.at(a).parent;
+			auto direction = parent->position - a->position;
+			auto dir = glm::abs(direction.x) > glm::abs(direction.y) ?
+				(direction.x > 0.0f ? NavDirection::Left : NavDirection::Right) :
+				(direction.y > 0.0f ? NavDirection::Forward : NavDirection::Back);
+			if (!a->isNeighbour(parent) && mNavMesh->findLadderNeighbour(a) != parent)
+			{
+				for (auto area = get_open_neighbour(a, dir); area != nullptr && area != parent; area = get_open_neighbour(area, dir))
+					areas.push_back(area);
+			}
+			areas.push_back(parent);
+			a = parent;
+		}
+		return pullNavChain(areas);
+	};
+
+	auto add_successor = [&](NavArea* area, NavArea* successor, std::optional<NavDirection> dir, float cost) {
+		if (closed_list.contains(successor))
+			return;
+
+		auto cost_to_start = infos.at(area).cost_to_start + cost;
+		cost_to_start += mInfluence.get(successor, now) * NavInfluenceCost;
+
+		bool successor_is_better = !infos.contains(successor) || infos.at(successor).cost_to_start > cost_to_start;
+
+		if (!successor_is_better)
+			return;
+
+		open_list.insert(successor);
+
+		auto& info = infos[successor];
+		info.parent = area;
+		info.dir = dir;
+		info.cost_to_finish = glm::distance(successor->position, src_area->position);
+		info.cost_to_start = cost_to_start;
+	};
+
+	auto& dst_area_info = infos[dst_area];
+	dst_area_info.cost_to_finish = glm::distance(dst_area->position, src_area->position);
+	open_list.insert(dst_area);
+
+	while (!open_list.empty())
+	{
+		auto area = find_best_from_open_list();
+
+		if (area == src_area)
+			return assemble_chain(area);
+
+		open_list.erase(area);
+		closed_list.insert(area);
+		mCounters.expansions += 1;
+
+		if (is_special(area))
+		{
+			// every link, the same rules as the region search
+			for (auto dir : Directions)
+			{
+				auto neighbour_nn = area->getNeighbour(dir);
+
+				if (neighbour_nn == nullptr)
+					continue;
+
+				auto link = neighbour_nn->getLink(OppositeDirections.at(dir)); // the way we will actually walk
+
+				if (link == nullptr || link->area != area)
+					continue; // do not allow one-way connections, because we swap src and dst areas
+
+				auto penalty = link->getPenalty(now);
+
+				if (penalty >= NavLinkBlockedPenalty)
+					continue; // we got stuck here again and again lately
+
+				auto cost = glm::distance(area->position, neighbour_nn->position) * GetTraversalCostMultiplier(link->traversal);
+				add_successor(area, neighbour_nn, dir, cost + penalty);
+			}
+
+			if (auto ladder_neighbour = mNavMesh->findLadderNeighbour(area); ladder_neighbour != nullptr)
+			{
+				auto cost = glm::distance(area->position, ladder_neighbour->position) * GetTraversalCostMultiplier(NavTraversal::Ladder);
+				add_successor(area, ladder_neighbour, std::nullopt, cost); // ladders go both ways
+			}
+
+			continue;
+		}
+
+		auto arrival = infos.at(area).dir;
+
+		for (auto dir : Directions)
+		{
+			if (arrival.has_value() && dir == OppositeDirections.at(arrival.value()))
+				continue; // where we came from
+
+			auto jump_point = jump(jump, area, dir);
+
+			if (jump_point == nullptr)
+				continue;
+
+			add_successor(area, jump_point, dir, glm::distance(area->position, jump_point->position));
+		}
+	}
+
+	return { };
+}
+
+float Navigator::GetAreaCostMultiplier(const NavArea* area)
+{
+	// areas near walls are expensive, so paths keep off them
+	const float total_penalty = 16.0f;
+	float result = total_penalty;
+	for (auto dir : Directions)
+	{
+		if (area->getNeighbour(dir) == nullptr)
+			continue;
+
+		result -= total_penalty / static_cast<float>(Directions.size());
+	}
+	return result + 1.0f;
+}
+
+float Navigator::GetTraversalCostMultiplier(NavTraversal traversal)
+{
+	switch (traversal)
+	{
+	case NavTraversal::Walk: return 1.0f;
+	case NavTraversal::Step: return 1.1f;
+	case NavTraversal::Drop: return 1.25f;
+	case NavTraversal::DuckOnly: return 2.0f;
+	case NavTraversal::Jump: return 2.0f;
+	case NavTraversal::CrouchJump: return 3.0f;
+	case NavTraversal::Ladder: return 1.5f;
+	}
+	return 1.0f;
+}
+
+std::optional<NavChain> Navigator::buildNavChainFromFlowField(SharedNavMesh::OwnerId owner, NavArea* src_area, NavArea* dst_area) const
+{
+	// the next few hops of the shared field, string pulled like a planned chain
+
+	mNavMesh->requestFlowField(owner, dst_area->position);
+
+	auto field = mNavMesh->findFlowField(dst_area->position);
+
+	if (field == nullptr)
+		return std::nullopt; // the mesh builder makes it once another bot asks for it too
+
+	if (field->find(src_area->position) == nullptr)
+		return std::nullopt; // not reached by the field yet
+
+	std::vector<NavArea*> areas = { src_area };
+
+	while (areas.size() < FlowFieldLookahead && areas.back() != dst_area)
+	{
+		auto entry = field->find(areas.back()->position);
+
+		if (entry == nullptr)
+			break;
+
+		auto next = mNavMesh->findExactArea(entry->next, 1.0f);
+
+		if (next == nullptr || next == areas.back())
+			break; // paged out, or the destination
+
+		areas.push_back(next);
+	}
+
+	return pullNavChain(areas);
+}
+
+void Navigator::updateFlowFields(size_t max_builds)
+{
+	// the costs of the planners, without the threat of this agent, fields are shared
+	auto now = Clock::Now();
+
+	mNavMesh->updateFlowFields([&](const NavArea* area, const NavLink& link) {
+		auto penalty = link.getPenalty(now);
+
+		if (penalty >= NavLinkBlockedPenalty)
+			return -1.0f;
+
+		auto cost_multiplier = GetAreaCostMultiplier(area) * GetTraversalCostMultiplier(link.traversal);
+		return glm::distance(area->position, link.area->position) * cost_multiplier + penalty;
+	}, max_builds);
+}
+
+bool Navigator::penalizeNavLink(const glm::vec3& from, const glm::vec3& towards)
+{
+	auto area = NavMesh::FindNearestArea(mNavMesh->getExploredAreas(), from);
+
+	if (area == nullptr)
+		return false;
+
+	auto direction = towards - area->position;
+	direction.z = 0.0f;
+
+	if (glm::length(direction) <= 0.0f)
+		return false;
+
+	direction = glm::normalize(direction);
+
+	std::optional<NavDirection> best_dir;
+	float best_dot = 0.0f;
+
+	for (auto dir : Directions)
+	{
+		auto link = area->getLink(dir);
+
+		if (link == nullptr)
+			continue;
+
+		auto link_direction = link->area->position - area->position;
+		link_direction.z = 0.0f;
+
+		auto dot = glm::dot(glm::normalize(link_direction), direction);
+
+		if (dot <= best_dot)
+			continue;
+
+		best_dir = dir;
+		best_dot = dot;
+	}
+
+	if (!best_dir.has_value())
+		return false;
+
+	area->addLinkPenalty(best_dir.value(), NavLinkStuckPenalty, Clock::Now());
+	mNavMesh->markPenaltiesChanged(area, area->getNeighbour(best_dir.value()));
+	return true;
+}
+
+NavChain Navigator::pullNavChain(const std::vector<NavArea*>& areas) const
+{
+	// string pulling: from every kept waypoint jump to the farthest area
+	// that is still reachable by a straight line over the mesh,
+	// areas are in walking order, result is reversed so the next waypoint is at back()
+
+	NavChain result;
+
+	if (areas.empty())
+		return result;
+
+	size_t anchor = 0;
+	result.push_back({ .position = areas.at(anchor)->position });
+
+	while (anchor < areas.size() - 1)
+	{
+		auto next = anchor + 1;
+
+		while (next + 1 < areas.size() && isNavLineWalkable(areas.at(anchor), areas.at(next + 1)))
+			next += 1;
+
+		auto traversal = NavTraversal::Walk;
+
+		if (next == anchor + 1)
+		{
+			auto link = areas.at(anchor)->findLink(areas.at(next));
+			if (link != nullptr)
+				traversal = link->traversal;
+			else if (areas.at(anchor)->region != areas.at(next)->region)
+				traversal = NavTraversal::Ladder; // ladders are the only links off the grid, inside a region we walk
+		}
+
+		result.push_back({ .position = areas.at(next)->position, .traversal = traversal });
+		anchor = next;
+	}
+
+	std::reverse(result.begin(), result.end());
+	return result;
+}
+
+bool Navigator::isNavLineWalkable(NavArea* src_area, NavArea* dst_area) const
+{
+	// walks grid cells along the src-dst line using only bidirectional links,
+	// diagonal parts of the line require both axis neighbours, so we never cut wall corners.
+	// penalized links and threatened areas break the line, the planner went around them for a reason
+
+	const glm::vec2 src = { src_area->position.x, src_area->position.y };
+	const glm::vec2 dst = { dst_area->position.x, dst_area->position.y };
+	const auto line = dst - src;
+	const auto line_length = glm::length(line);
+
+	if (line_length <= 0.0f)
+		return true;
+
+	auto distance_to_line = [&](const glm::vec3& pos) {
+		auto v = glm::vec2{ pos.x, pos.y } - src;
+		return glm::abs(v.x * line.y - v.y * line.x) / line_length;
+	};
+
+	auto now = Clock::Now();
+
+	auto get_walkable_neighbour = [&](NavArea* area, NavDirection dir) -> NavArea* {
+		auto link = area->getLink(dir);
+
+		if (link == nullptr)
+			return nullptr;
+
+		if (link->traversal != NavTraversal::Walk && link->traversal != NavTraversal::Step)
+			return nullptr;
+
+		if (link->area->getNeighbour(OppositeDirections.at(dir)) != area)
+			return nullptr;
+
+		if (link->getPenalty(now) > NavMesh::RegionMaxPenalty)
+			return nullptr;
+
+		if (link->area != dst_area && mInfluence.get(link->area, now) > InfluenceMap::MinValue)
+			return nullptr;
+
+		return link->area;
+	};
+
+	const auto step = mNavMesh->getStep();
+	const auto max_steps = static_cast<int>((glm::abs(line.x) + glm::abs(line.y)) / step) + 2;
+
+	auto area = src_area;
+
+	for (int i = 0; i < max_steps; i++)
+	{
+		if (area == dst_area)
+			return true;
+
+		auto delta_x = dst.x - area->position.x;
+		auto delta_y = dst.y - area->position.y;
+
+		bool step_x = glm::abs(delta_x) >= step * 0.5f;
+		bool step_y = glm::abs(delta_y) >= step * 0.5f;
+
+		if (!step_x && !step_y)
+			return false;
+
+		auto dir_x = delta_x > 0.0f ? NavDirection::Left : NavDirection::Right;
+		auto dir_y = delta_y > 0.0f ? NavDirection::Forward : NavDirection::Back;
+
+		auto neighbour_x = step_x ? get_walkable_neighbour(area, dir_x) : nullptr;
+		auto neighbour_y = step_y ? get_walkable_neighbour(area, dir_y) : nullptr;
+
+		if (step_x && neighbour_x == nullptr)
+			return false;
+
+		if (step_y && neighbour_y == nullptr)
+			return false;
+
+		if (neighbour_x == nullptr)
+			area = neighbour_y;
+		else if (neighbour_y == nullptr)
+			area = neighbour_x;
+		else if (distance_to_line(neighbour_x->position) <= distance_to_line(neighbour_y->position))
+			area = neighbour_x;
+		else
+			area = neighbour_y;
+	}
+
+	return false;
+}
\ No newline at end of file
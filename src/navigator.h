@@ -0,0 +1,121 @@
+#pragma once
+
+#include <HL/bspfile.h>
+#include "shared_nav_mesh.h"
+#include "influence_map.h"
+#include "bsp_hulls.h"
+#include <set>
+#include <string>
+
+// world traces, nav mesh building and path planning for a player sized agent,
+// does not depend on a server connection, so it can also be driven offline (see bench/)
+
+class Navigator
+{
+protected:
+	const float PlayerHeightStand = 72.0f;
+	const float PlayerHeightDuck = 36.0f;
+	const float PlayerOriginZStand = 36.0f;
+	const float PlayerOriginZDuck = 18.0f;
+	const float PlayerWidth = 32.0f;
+	const float StepHeight = 18.0f; // if delta Z is greater than this, we have to jump to get up (MoveVars.stepsize)
+	const float JumpHeight = 41.8f; // if delta Z is less than this, we can jump up on it
+	const float JumpCrouchHeight = 58.0f; // (48) if delta Z is less than or equal to this, we can jumpcrouch up on it
+	const float MaxDistance = 8192.0f;
+
+	const float NavStep = PlayerWidth * 1.0f;
+	const float NavExploreDistance = 256.0f;
+	const size_t NavScratchSize = 256 * 1024;
+	const float NavInfluenceCost = 256.0f; // extra path cost of an area with full threat
+	const float NavLinkStuckPenalty = 768.0f; // extra path cost of a link we got stuck on
+	const float NavLinkBlockedPenalty = 1000.0f; // the planner does not use links penalized above this
+	const size_t FlowFieldLookahead = 32; // areas followed per flow field chain
+
+public:
+	void loadBsp(const std::string& path);
+	void setBsp(BSPFile&& bsp_file, BspHulls&& bsp_hulls); // already loaded elsewhere, see MapPrewarm
+
+public:
+	struct TraceResult
+	{
+		glm::vec3 endpos = { 0.0f, 0.0f, 0.0f };
+		float fraction = 0.0f;
+		bool start_solid = false;
+		glm::vec3 plane_normal = { 0.0f, 0.0f, 0.0f }; // hull traces only
+	};
+
+	TraceResult traceLine(const glm::vec3& begin, const glm::vec3& end) const;
+	TraceResult traceHull(const glm::vec3& begin, const glm::vec3& end, BspHull hull) const; // begin and end are hull centers
+	std::optional<glm::vec3> getGroundFromOrigin(const glm::vec3& origin, BspHull hull = BspHull::Point) const; // bottom of the hull
+	std::optional<glm::vec3> getRoofFromOrigin(const glm::vec3& origin, BspHull hull = BspHull::Point) const; // top of the hull
+	bool isVisible(const glm::vec3& eye, const glm::vec3& target) const;
+	bool isInLadder(const glm::vec3& origin, BspHull hull) const;
+	const BspHulls::Ladder* findNearestLadder(const glm::vec3& origin) const;
+	bool isVisibleCached(const glm::vec3& eye, const glm::vec3& target) const; // nav visibility table first, traces only close calls
+	size_t updateNavVisibility(size_t max_traces);
+
+public:
+	enum class BuildNavMeshStatus
+	{
+		Finished,
+		Processing
+	};
+
+	BuildNavMeshStatus buildNavMesh(const glm::vec3& start_ground_point, const glm::vec3& origin, std::optional<Clock::TimePoint> deadline = std::nullopt); // with a deadline it grows until then, not just one ring of probes
+	BuildNavMeshStatus buildNavMesh(NavArea* base_area);
+	NavChain buildNavChain(NavArea* src_area, NavArea* dst_area); // over regions, or over jump points of the grid
+	std::optional<NavChain> buildNavChainFromFlowField(SharedNavMesh::OwnerId owner, NavArea* src_area, NavArea* dst_area) const; // nullopt until the field is built
+	void updateFlowFields(size_t max_builds); // unique lock
+	bool penalizeNavLink(const glm::vec3& from, const glm::vec3& towards); // the link of the nearest area that leads towards
+
+protected:
+	float getHullHalfHeight(BspHull hull) const;
+	void linkLadders();
+	std::optional<NavChain> buildNavChainOverRegions(NavArea* src_area, NavArea* dst_area); // nullopt when a grid search has to take over
+	NavChain buildNavChainOverJumpPoints(NavArea* src_area, NavArea* dst_area);
+	static float GetTraversalCostMultiplier(NavTraversal traversal);
+	static float GetAreaCostMultiplier(const NavArea* area);
+	std::optional<NavLink> makeNavLink(const glm::vec3& src_ground, const glm::vec3& dst_ground, bool over_obstacle) const;
+	NavChain pullNavChain(const std::vector<NavArea*>& areas) const;
+	bool isNavLineWalkable(NavArea* src_area, NavArea* dst_area) const;
+
+public:
+	const auto& getBsp() const { return mBspFile; }
+	void setBspModelOrigin(int model_index, const glm::vec3& origin);
+	const SharedNavMesh& getNavMesh() const { return *mNavMesh; }
+	SharedNavMesh& getNavMesh() { return *mNavMesh; }
+	void setNavMesh(std::shared_ptr<SharedNavMesh> value) { mNavMesh = value; }
+
+	auto getNavExploreDistance() const { return mNavExploreDistance; }
+	void setNavExploreDistance(float value) { mNavExploreDistance = value; }
+
+	auto getNavStep() const { return mNavMesh->getStep(); } // of the mesh we build, see setNavStep()
+	void setNavStep(float value) { mNavStep = value; } // for meshes this agent is the first to acquire
+
+	auto isNavJumpPoints() const { return mNavJumpPoints; }
+	void setNavJumpPoints(bool value) { mNavJumpPoints = value; }
+
+	const auto& getInfluence() const { return mInfluence; }
+	auto& getInfluence() { return mInfluence; }
+
+	struct Counters
+	{
+		uint32_t traces = 0;
+		uint32_t expansions = 0; // areas taken from the open lists of the mesh builder and the planner
+	};
+
+	const auto& getCounters() const { return mCounters; }
+	void resetCounters() { mCounters = {}; }
+
+protected:
+	BSPFile mBspFile;
+	BspHulls mBspHulls;
+	std::set<int> mBspModelIndices;
+	std::shared_ptr<SharedNavMesh> mNavMesh = std::make_shared<SharedNavMesh>(); // private until setNavMesh()
+	float mNavExploreDistance = NavExploreDistance;
+	float mNavStep = NavStep; // requested, the mesh may already have another one
+	bool mNavJumpPoints = false; // plan with jump point search over the grid instead of a* over regions
+	std::vector<std::byte> mNavScratch = std::vector<std::byte>(NavScratchSize); // backing storage for per-call nav temporaries
+	mutable Counters mCounters;
+	InfluenceMap mInfluence; // of this agent, not shared with the mesh
+};
@@ -0,0 +1,193 @@
+#include "shared_nav_mesh.h"
+#include <atomic>
+#include <map>
+#include <algorithm>
+#include <random>
+#include <filesystem>
+
+std::shared_ptr<SharedNavMesh> SharedNavMesh::Acquire(const std::string& map, const std::optional<MapStore::Hash>& hash, float step)
+{
+	static std::mutex mutex;
+	static std::map<std::string, std::weak_ptr<SharedNavMesh>> meshes;
+
+	std::lock_guard lock(mutex);
+
+	auto& weak = meshes[hash.has_value() ? MapStore::HashToString(hash.value()) : map];
+	auto result = weak.lock();
+
+	if (result == nullptr)
+	{
+		result = std::make_shared<SharedNavMesh>();
+		result->mMap = map;
+		result->setStep(step);
+		weak = result;
+
+		// paged out tiles go to disk, unique per mesh, so processes on the same map do not collide
+		std::random_device random;
+		auto name = std::filesystem::path(map).stem().string() + "_" + std::to_string(random()) + std::to_string(random());
+		std::error_code ec;
+		auto temp = std::filesystem::temp_directory_path(ec);
+
+		if (!ec)
+			result->setPageDirectory(temp / "xclient" / "nav" / name);
+	}
+
+	// forget maps nobody plays anymore
+	std::erase_if(meshes, [](const auto& pair) {
+		return pair.second.expired();
+	});
+
+	return result;
+}
+
+void SharedNavMesh::clear()
+{
+	NavMesh::clear();
+	mVisibility.clear();
+	mFlowFields.clear();
+	mGeneration.fetch_add(1, std::memory_order_release);
+
+	std::lock_guard lock(mReservationsMutex);
+	mReservations.clear();
+}
+
+const FlowField* SharedNavMesh::findFlowField(const glm::vec3& destination) const
+{
+	auto it = mFlowFields.find(GetPositionKey(destination));
+
+	if (it == mFlowFields.end())
+		return nullptr;
+
+	return it->second.get();
+}
+
+void SharedNavMesh::requestFlowField(OwnerId owner, const glm::vec3& destination)
+{
+	std::lock_guard lock(mFlowRequestsMutex);
+	auto& request = mFlowRequests[GetPositionKey(destination)];
+	request.destination = destination;
+	request.owners[owner] = Clock::Now();
+}
+
+void SharedNavMesh::updateFlowFields(const FlowField::CostFunction& get_cost, size_t max_builds)
+{
+	auto now = Clock::Now();
+
+	std::vector<std::pair<uint64_t, glm::vec3>> requests;
+
+	{
+		std::lock_guard lock(mFlowRequestsMutex);
+
+		for (auto& [key, request] : mFlowRequests)
+		{
+			std::erase_if(request.owners, [&](const auto& pair) {
+				return now - pair.second > Clock::FromSeconds(FlowFieldIdleSeconds);
+			});
+		}
+
+		std::erase_if(mFlowRequests, [](const auto& pair) {
+			return pair.second.owners.empty();
+		});
+
+		// a full mesh search pays off only when its field is followed by more than one bot
+		for (const auto& [key, request] : mFlowRequests)
+		{
+			if (request.owners.size() >= FlowFieldMinOwners)
+				requests.push_back({ key, request.destination });
+		}
+	}
+
+	std::erase_if(mFlowFields, [&](const auto& pair) {
+		return std::none_of(requests.begin(), requests.end(), [&](const auto& request) {
+			return request.first == pair.first;
+		});
+	});
+
+	size_t builds = 0;
+
+	for (const auto& [key, destination] : requests)
+	{
+		auto& field = mFlowFields[key];
+
+		if (field != nullptr && !field->isOutdated(*this))
+		{
+			if (field->isStale(*this))
+				field->patch(*this, get_cost);
+
+			continue;
+		}
+
+		if (builds >= max_builds)
+		{
+			if (field == nullptr)
+				mFlowFields.erase(key);
+
+			continue;
+		}
+
+		builds += 1;
+
+		if (field == nullptr)
+			field = std::make_unique<FlowField>(destination);
+
+		if (!field->build(*this, get_cost))
+			mFlowFields.erase(key); // destination is paged out, we try again next time
+	}
+}
+
+SharedNavMesh::OwnerId SharedNavMesh::MakeOwnerId()
+{
+	static std::atomic<OwnerId> counter = 0;
+	return ++counter;
+}
+
+void SharedNavMesh::reserveFrontier(OwnerId owner, const glm::vec3& position, float radius, Clock::Duration duration)
+{
+	std::lock_guard lock(mReservationsMutex);
+
+	auto now = Clock::Now();
+
+	// one reservation per owner, the new one replaces the old one
+	std::erase_if(mReservations, [&](const Reservation& reservation) {
+		return reservation.owner == owner || reservation.expire_time < now;
+	});
+
+	Reservation reservation;
+	reservation.owner = owner;
+	reservation.position = position;
+	reservation.radius = radius;
+	reservation.expire_time = now + duration;
+	mReservations.push_back(reservation);
+}
+
+void SharedNavMesh::releaseFrontier(OwnerId owner)
+{
+	std::lock_guard lock(mReservationsMutex);
+
+	std::erase_if(mReservations, [&](const Reservation& reservation) {
+		return reservation.owner == owner;
+	});
+}
+
+bool SharedNavMesh::isFrontierReserved(OwnerId owner, const glm::vec3& position) const
+{
+	std::lock_guard lock(mReservationsMutex);
+
+	auto now = Clock::Now();
+
+	for (const auto& reservation : mReservations)
+	{
+		if (reservation.owner == owner)
+			continue;
+
+		if (reservation.expire_time < now)
+			continue;
+
+		if (glm::distance(reservation.position, position) > reservation.radius)
+			continue;
+
+		return true;
+	}
+
+	return false;
+}
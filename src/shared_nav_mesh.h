@@ -0,0 +1,81 @@
+#pragma once
+
+#include "nav_mesh.h"
+#include "nav_visibility.h"
+#include "flow_field.h"
+#include "map_store.h"
+#include <common/clock.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// nav mesh that every bot of this process playing the same map builds and reads together.
+// growth needs the unique lock, planning and lookups need the shared lock.
+// frontier reservations have their own lock, so they can be made while planning
+
+class SharedNavMesh : public NavMesh
+{
+public:
+	// by the md5 of the bsp, so different maps with the same name get their own meshes, the name is used without it.
+	// step of a new mesh, bots joining an existing one adopt its step
+	static std::shared_ptr<SharedNavMesh> Acquire(const std::string& map, const std::optional<MapStore::Hash>& hash, float step = DefaultStep);
+
+public:
+	void clear(); // for every bot holding the mesh, they notice by the generation
+	const std::string& getMap() const { return mMap; } // it was acquired for
+	uint32_t getGeneration() const { return mGeneration.load(std::memory_order_acquire); } // any lock
+
+	auto& getMutex() const { return mMutex; }
+
+	// follows the nav lock, written by the mesh builder, read by planners
+	const auto& getVisibility() const { return mVisibility; }
+	auto& getVisibility() { return mVisibility; }
+
+public:
+	using OwnerId = uint64_t;
+
+	static OwnerId MakeOwnerId();
+
+	// flow fields towards the destinations several bots ask for, built and patched under the unique lock, read under the shared one
+	const FlowField* findFlowField(const glm::vec3& destination) const;
+	void requestFlowField(OwnerId owner, const glm::vec3& destination); // any lock, keeps the field alive
+	void updateFlowFields(const FlowField::CostFunction& get_cost, size_t max_builds);
+	size_t getFlowFieldsCount() const { return mFlowFields.size(); }
+
+	static constexpr float FlowFieldIdleSeconds = 10.0f; // requests older than this are dropped
+	static constexpr size_t FlowFieldMinOwners = 2; // a destination of a single bot is planned by that bot alone
+
+	void reserveFrontier(OwnerId owner, const glm::vec3& position, float radius, Clock::Duration duration);
+	void releaseFrontier(OwnerId owner);
+	bool isFrontierReserved(OwnerId owner, const glm::vec3& position) const; // by someone else
+
+private:
+	struct Reservation
+	{
+		OwnerId owner = 0;
+		glm::vec3 position = { 0.0f, 0.0f, 0.0f };
+		float radius = 0.0f;
+		Clock::TimePoint expire_time;
+	};
+
+	std::string mMap;
+	mutable std::shared_mutex mMutex;
+	std::atomic<uint32_t> mGeneration = 0;
+	NavVisibility mVisibility;
+	std::unordered_map<uint64_t, std::unique_ptr<FlowField>> mFlowFields; // by destination position key
+	mutable std::mutex mFlowRequestsMutex;
+
+	struct FlowRequest
+	{
+		glm::vec3 destination = { 0.0f, 0.0f, 0.0f };
+		std::unordered_map<OwnerId, Clock::TimePoint> owners; // and their last request time
+	};
+
+	std::unordered_map<uint64_t, FlowRequest> mFlowRequests; // by destination position key
+	mutable std::mutex mReservationsMutex;
+	std::vector<Reservation> mReservations;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <optional>
+
+// bounded lock-free queue for exactly one producer thread and one consumer thread
+
+template <typename T, size_t Capacity> class SpscQueue
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+	bool push(const T& value)
+	{
+		auto tail = mTail.load(std::memory_order_relaxed);
+
+		if (tail - mHead.load(std::memory_order_acquire) >= Capacity)
+			return false;
+
+		mItems[tail & (Capacity - 1)] = value;
+		mTail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	std::optional<T> pop()
+	{
+		auto head = mHead.load(std::memory_order_relaxed);
+
+		if (head == mTail.load(std::memory_order_acquire))
+			return std::nullopt;
+
+		auto value = mItems[head & (Capacity - 1)];
+		mHead.store(head + 1, std::memory_order_release);
+		return value;
+	}
+
+private:
+	std::array<T, Capacity> mItems;
+	alignas(64) std::atomic<size_t> mHead = 0;
+	alignas(64) std::atomic<size_t> mTail = 0;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <common/clock.h>
+#include <optional>
+
+// fixed-rate cadence, independent of how often the host calls us (render frames, network frames)
+// rate is in hz, rate <= 0 means "every call"
+
+class ThinkScheduler
+{
+public:
+	bool isDue(Clock::TimePoint now, float rate)
+	{
+		if (rate > 0.0f)
+		{
+			if (mNextTime.has_value() && now < mNextTime.value())
+				return false;
+
+			auto interval = Clock::FromSeconds(1.0f / rate);
+
+			// keep the cadence stable, but do not try to catch up after long stalls
+			if (!mNextTime.has_value() || now - mNextTime.value() >= interval)
+				mNextTime = now + interval;
+			else
+				mNextTime = mNextTime.value() + interval;
+		}
+		else
+		{
+			mNextTime.reset();
+		}
+
+		mDelta = mPrevTime.has_value() ? now - mPrevTime.value() : Clock::Duration::zero();
+		mPrevTime = now;
+		return true;
+	}
+
+	void reset()
+	{
+		mNextTime.reset();
+		mPrevTime.reset();
+	}
+
+	auto getDelta() const { return mDelta; }
+
+private:
+	std::optional<Clock::TimePoint> mNextTime;
+	std::optional<Clock::TimePoint> mPrevTime;
+	Clock::Duration mDelta = Clock::Duration::zero();
+};
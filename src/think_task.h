@@ -0,0 +1,177 @@
+#pragma once
+
+#include <common/clock.h>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include <algorithm>
+
+// think logic that spans ticks, as c++20 coroutines. the executor resumes every task once per tick,
+// a task runs until it co_awaits nextTick() (waiting on purpose) or checkpoint() after the tick budget is spent.
+// tasks must not hold locks or nav mesh pointers across a suspension, other bots change the mesh in between.
+// a task that throws is dropped and reported to the failure callback, the other tasks keep running
+
+class ThinkTask
+{
+public:
+	struct promise_type
+	{
+		ThinkTask get_return_object() { return ThinkTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept { return {}; } // the executor starts it on its next tick
+		std::suspend_always final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { exception = std::current_exception(); }
+
+		std::exception_ptr exception;
+	};
+
+public:
+	ThinkTask() = default;
+	ThinkTask(const ThinkTask&) = delete;
+	ThinkTask(ThinkTask&& other) noexcept : mHandle(std::exchange(other.mHandle, nullptr)) {}
+	~ThinkTask() { if (mHandle) mHandle.destroy(); }
+
+	ThinkTask& operator=(const ThinkTask&) = delete;
+	ThinkTask& operator=(ThinkTask&& other) noexcept
+	{
+		if (this != &other)
+		{
+			if (mHandle)
+				mHandle.destroy();
+
+			mHandle = std::exchange(other.mHandle, nullptr);
+		}
+		return *this;
+	}
+
+	bool isDone() const { return !mHandle || mHandle.done(); }
+
+	void resume()
+	{
+		mHandle.resume();
+
+		if (mHandle.done() && mHandle.promise().exception)
+			std::rethrow_exception(std::exchange(mHandle.promise().exception, nullptr));
+	}
+
+private:
+	explicit ThinkTask(std::coroutine_handle<promise_type> handle) : mHandle(handle) {}
+
+private:
+	std::coroutine_handle<promise_type> mHandle = nullptr;
+};
+
+class ThinkExecutor
+{
+public:
+	// suspends until the next tick
+	struct NextTick
+	{
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<>) const noexcept {}
+		void await_resume() const noexcept {}
+	};
+
+	// suspends until the next tick only when the budget of this one is spent
+	struct Checkpoint
+	{
+		const ThinkExecutor& executor;
+
+		bool await_ready() const noexcept { return !executor.isOverBudget(); }
+		void await_suspend(std::coroutine_handle<>) const noexcept {}
+		void await_resume() const noexcept {}
+	};
+
+public:
+	// the task starts on the next tick, it replaces a task with the same name
+	void spawn(const std::string& name, ThinkTask task)
+	{
+		mSpawned.push_back({ name, std::move(task) });
+	}
+
+	void cancelAll() // outside of tick() only
+	{
+		mTasks.clear();
+		mSpawned.clear();
+	}
+
+	using FailureCallback = std::function<void(const std::string& name, const std::string& what)>;
+
+	void setFailureCallback(FailureCallback value) { mFailureCallback = std::move(value); }
+
+	bool isRunning(const std::string& name) const
+	{
+		auto is_named = [&](const Entry& entry) { return entry.name == name; };
+		return std::any_of(mTasks.begin(), mTasks.end(), is_named) || std::any_of(mSpawned.begin(), mSpawned.end(), is_named);
+	}
+
+	void tick(Clock::Duration budget)
+	{
+		mDeadline = Clock::Now() + budget;
+
+		for (auto& spawned : mSpawned)
+		{
+			std::erase_if(mTasks, [&](const Entry& entry) { return entry.name == spawned.name; });
+			mTasks.push_back(std::move(spawned));
+		}
+
+		mSpawned.clear();
+
+		// everyone runs once, who goes first rotates, so a greedy task does not starve the rest
+		auto count = mTasks.size();
+
+		for (size_t i = 0; i < count; i++)
+		{
+			auto& entry = mTasks[(mFirst + i) % count];
+
+			if (entry.task.isDone())
+				continue;
+
+			try
+			{
+				entry.task.resume();
+			}
+			catch (const std::exception& e)
+			{
+				onFailure(entry.name, e.what());
+			}
+			catch (...)
+			{
+				onFailure(entry.name, "unknown exception");
+			}
+		}
+
+		mFirst = count > 0 ? (mFirst + 1) % count : 0;
+
+		std::erase_if(mTasks, [](const Entry& entry) { return entry.task.isDone(); }); // thrown ones as well
+	}
+
+	bool isOverBudget() const { return Clock::Now() >= mDeadline; }
+	auto getDeadline() const { return mDeadline; }
+	size_t getTasksCount() const { return mTasks.size() + mSpawned.size(); }
+
+	Checkpoint checkpoint() const { return { *this }; }
+	static NextTick nextTick() { return {}; }
+
+private:
+	struct Entry
+	{
+		std::string name;
+		ThinkTask task;
+	};
+
+	void onFailure(const std::string& name, const std::string& what) const
+	{
+		if (mFailureCallback)
+			mFailureCallback(name, what);
+	}
+
+	std::vector<Entry> mTasks;
+	std::vector<Entry> mSpawned; // during tick(), they join the next one
+	Clock::TimePoint mDeadline = Clock::Now();
+	size_t mFirst = 0;
+	FailureCallback mFailureCallback;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// lock-free single producer / single consumer handoff of the latest value.
+// the producer fills getWriteBuffer() and publish()es it, the consumer calls update()
+// and reads getReadBuffer(), which stays untouched by the producer until the next update().
+// values that were published but never picked up are simply overwritten
+
+template <typename T> class TripleBuffer
+{
+public:
+	// producer side
+
+	T& getWriteBuffer() { return mBuffers[mWriteIndex]; }
+
+	void publish()
+	{
+		auto prev = mShared.exchange(mWriteIndex | DirtyBit, std::memory_order_acq_rel);
+		mWriteIndex = prev & IndexMask;
+	}
+
+	// consumer side, returns false when nothing new was published since the last update
+
+	bool update()
+	{
+		if ((mShared.load(std::memory_order_relaxed) & DirtyBit) == 0)
+			return false;
+
+		auto prev = mShared.exchange(mReadIndex, std::memory_order_acq_rel);
+		mReadIndex = prev & IndexMask;
+		return true;
+	}
+
+	const T& getReadBuffer() const { return mBuffers[mReadIndex]; }
+
+private:
+	static constexpr uint8_t DirtyBit = 0x4;
+	static constexpr uint8_t IndexMask = 0x3;
+
+	std::array<T, 3> mBuffers;
+	uint8_t mWriteIndex = 0; // owned by the producer
+	uint8_t mReadIndex = 1; // owned by the consumer
+	std::atomic<uint8_t> mShared = 2;
+};
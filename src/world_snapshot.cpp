@@ -0,0 +1,49 @@
+#include "world_snapshot.h"
+
+glm::vec3 WorldSnapshot::getOrigin() const
+{
+	return client_data.origin;
+}
+
+bool WorldSnapshot::isOnGround() const
+{
+	return client_data.flags & FL_ONGROUND;
+}
+
+bool WorldSnapshot::isAlive() const
+{
+	return
+		!isSpectator() &&
+		(getHealth() > 0.0f) &&
+		(client_data.deadflag == DEAD_NO);
+}
+
+bool WorldSnapshot::isSpectator() const
+{
+	return client_data.flags & FL_SPECTATOR;
+}
+
+bool WorldSnapshot::isDucking() const
+{
+	return client_data.flags & FL_DUCKING;
+}
+
+float WorldSnapshot::getHealth() const
+{
+	return client_data.health;
+}
+
+float WorldSnapshot::getSpeed() const
+{
+	return glm::length(client_data.velocity);
+}
+
+float WorldSnapshot::getMaxSpeed() const
+{
+	float speed = client_data.maxspeed;
+
+	if (speed <= 0.0f && move_vars.has_value())
+		speed = move_vars.value().max_speed;
+
+	return speed;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "entity_snapshot.h"
+#include <common/clock.h>
+
+// everything the ai reads from the server for one think tick.
+// captured on the network thread, then only read by whoever runs the think logic
+
+struct WorldSnapshot
+{
+	Clock::TimePoint time;
+	Clock::Duration delta = Clock::Duration::zero(); // since the previous snapshot
+	HL::Protocol::ClientData client_data = {};
+	std::optional<HL::Protocol::MoveVars> move_vars;
+	EntitySnapshot entities;
+
+	glm::vec3 getOrigin() const;
+	bool isOnGround() const;
+	bool isAlive() const;
+	bool isSpectator() const;
+	bool isDucking() const;
+	float getHealth() const;
+	float getSpeed() const;
+	float getMaxSpeed() const;
+};
@@ -0,0 +1,108 @@
+// converts flight recorder dumps (see flight_dump command) into csv
+// usage: flight_decoder <input.xfr> [output.csv]
+
+#include <flight_record_format.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <string>
+
+static const char* GetBranchName(uint8_t branch)
+{
+	switch ((FlightRecordFormat::Branch)branch)
+	{
+	case FlightRecordFormat::Branch::None: return "none";
+	case FlightRecordFormat::Branch::AvoidPlayers: return "avoid";
+	case FlightRecordFormat::Branch::CustomTarget: return "custom_target";
+	case FlightRecordFormat::Branch::Explore: return "explore";
+	}
+	return "unknown";
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::fprintf(stderr, "usage: flight_decoder <input%s> [output.csv]\n", FlightRecordFormat::Extension);
+		return 1;
+	}
+
+	std::ifstream file(argv[1], std::ios::binary);
+
+	if (!file)
+	{
+		std::fprintf(stderr, "flight_decoder: cannot read %s\n", argv[1]);
+		return 1;
+	}
+
+	FlightRecordFormat::Header header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+	if (!file || header.magic != FlightRecordFormat::Magic || header.version != FlightRecordFormat::Version)
+	{
+		std::fprintf(stderr, "flight_decoder: %s is not a flight record\n", argv[1]);
+		return 1;
+	}
+
+	if (header.record_size != sizeof(FlightRecordFormat::Record))
+	{
+		std::fprintf(stderr, "flight_decoder: unexpected record size %u\n", header.record_size);
+		return 1;
+	}
+
+	std::vector<FlightRecordFormat::Record> records(header.record_count);
+	file.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(FlightRecordFormat::Record));
+
+	if (!file)
+	{
+		std::fprintf(stderr, "flight_decoder: %s is truncated\n", argv[1]);
+		return 1;
+	}
+
+	auto output = stdout;
+
+	if (argc > 2)
+	{
+		output = std::fopen(argv[2], "w");
+
+		if (output == nullptr)
+		{
+			std::fprintf(stderr, "flight_decoder: cannot write %s\n", argv[2]);
+			return 1;
+		}
+	}
+
+	std::fprintf(output, "time_ms,origin_x,origin_y,origin_z,speed,health,alive,on_ground,ducking,spectator,players,"
+		"branch,chain_length,traces,expansions,forwardmove,sidemove,upmove,pitch,yaw,buttons,"
+		"nav_mesh_us,movement_us,tick_us\n");
+
+	for (const auto& record : records)
+	{
+		std::fprintf(output, "%.3f,%.1f,%.1f,%.1f,%.1f,%.0f,%d,%d,%d,%d,%u,%s,%u,%u,%u,%.1f,%.1f,%.1f,%.2f,%.2f,%u,%u,%u,%u\n",
+			record.time / 1000.0,
+			record.origin[0], record.origin[1], record.origin[2],
+			record.speed,
+			record.health,
+			(record.state & FlightRecordFormat::Alive) ? 1 : 0,
+			(record.state & FlightRecordFormat::OnGround) ? 1 : 0,
+			(record.state & FlightRecordFormat::Ducking) ? 1 : 0,
+			(record.state & FlightRecordFormat::Spectator) ? 1 : 0,
+			(unsigned)record.players,
+			GetBranchName(record.branch),
+			(unsigned)record.chain_length,
+			record.traces,
+			record.expansions,
+			record.forwardmove, record.sidemove, record.upmove,
+			record.viewangles[0], record.viewangles[1],
+			(unsigned)record.buttons,
+			record.nav_mesh_time,
+			record.movement_time,
+			record.tick_time);
+	}
+
+	if (output != stdout)
+		std::fclose(output);
+
+	return 0;
+}
@@ -0,0 +1,289 @@
+// draws the nav mesh and the nav chain of a bot streaming on nav_stream_port, top down, in the terminal
+// usage: nav_viewer <port> [cells_per_row]
+
+#include <nav_stream_format.h>
+#include <local_socket.h>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+
+static const float RenderRate = 5.0f;
+
+// by NavTraversal, as the bot sends them
+static const char TraversalMarks[] = { '.', ':', 'j', 'c', 'd', 'v', 'H' };
+
+struct Viewer
+{
+	float nav_step = 32.0f;
+	std::unordered_map<uint64_t, std::vector<NavStreamFormat::Area>> tiles;
+	std::vector<NavStreamFormat::Waypoint> chain;
+	NavStreamFormat::Tick tick = {};
+	bool has_tick = false;
+};
+
+static bool ReceiveAll(LocalSocket::Handle socket, void* data, size_t size)
+{
+	auto bytes = reinterpret_cast<char*>(data);
+
+	while (size > 0)
+	{
+		auto result = ::recv(socket, bytes, (int)size, 0);
+
+		if (result <= 0)
+			return false;
+
+		bytes += result;
+		size -= (size_t)result;
+	}
+
+	return true;
+}
+
+static bool IsExplored(const NavStreamFormat::Area& area)
+{
+	return std::none_of(std::begin(area.links), std::end(area.links), [](uint8_t link) {
+		return link == NavStreamFormat::Unprobed;
+	});
+}
+
+static char GetAreaMark(const NavStreamFormat::Area& area)
+{
+	if (!IsExplored(area))
+		return 'o';
+
+	// the roughest way out of this area
+	uint8_t traversal = 0;
+
+	for (auto link : area.links)
+	{
+		if (link >= NavStreamFormat::Linked)
+			traversal = std::max<uint8_t>(traversal, link - NavStreamFormat::Linked);
+	}
+
+	if (traversal >= sizeof(TraversalMarks))
+		return '?';
+
+	return TraversalMarks[traversal];
+}
+
+static void Render(const Viewer& viewer, int columns)
+{
+	auto rows = columns / 2;
+	auto origin = viewer.tick.record.origin;
+
+	// cells hold the area closest to our height, so floors below and above do not cover ours
+	std::vector<char> cells((size_t)(columns * rows), ' ');
+	std::vector<float> heights((size_t)(columns * rows), INFINITY);
+
+	auto to_cell = [&](const float* position, int& x, int& y) {
+		x = (int)std::floor((position[0] - origin[0]) / viewer.nav_step + 0.5f) + columns / 2;
+		y = rows / 2 - (int)std::floor((position[1] - origin[1]) / viewer.nav_step + 0.5f);
+		return x >= 0 && x < columns && y >= 0 && y < rows;
+	};
+
+	size_t areas_count = 0;
+
+	for (const auto& [key, areas] : viewer.tiles)
+	{
+		areas_count += areas.size();
+
+		for (const auto& area : areas)
+		{
+			int x, y;
+
+			if (!to_cell(area.position, x, y))
+				continue;
+
+			auto height = std::abs(area.position[2] - origin[2]);
+			auto index = (size_t)(y * columns + x);
+
+			if (height >= heights[index])
+				continue;
+
+			heights[index] = height;
+			cells[index] = GetAreaMark(area);
+		}
+	}
+
+	for (size_t i = 1; i < viewer.chain.size(); i++)
+	{
+		const auto& a = viewer.chain[i - 1].position;
+		const auto& b = viewer.chain[i].position;
+		auto length = std::hypot(b[0] - a[0], b[1] - a[1]) / viewer.nav_step;
+		auto steps = std::max(1, (int)std::ceil(length));
+
+		for (int step = 0; step <= steps; step++)
+		{
+			auto t = (float)step / (float)steps;
+			float position[2] = { a[0] + (b[0] - a[0]) * t, a[1] + (b[1] - a[1]) * t };
+			int x, y;
+
+			if (to_cell(position, x, y))
+				cells[(size_t)(y * columns + x)] = '*';
+		}
+	}
+
+	int bot_x, bot_y;
+
+	if (to_cell(origin, bot_x, bot_y))
+		cells[(size_t)(bot_y * columns + bot_x)] = '@';
+
+	std::string frame = "\x1b[H\x1b[2J";
+
+	for (int y = 0; y < rows; y++)
+	{
+		frame.append(cells.begin() + y * columns, cells.begin() + (y + 1) * columns);
+		frame += '\n';
+	}
+
+	const auto& tick = viewer.tick;
+	const auto& record = tick.record;
+
+	char stats[512];
+	std::snprintf(stats, sizeof(stats),
+		"origin %.0f %.0f %.0f  yaw %.0f  speed %.0f  chain %zu\n"
+		"areas %zu (%u explored, %u unexplored)  tiles %u resident, %u paged  stuck %u\n"
+		"tick %.2f ms (nav mesh %.2f, movement %.2f)  traces %u  expansions %u\n",
+		origin[0], origin[1], origin[2], record.viewangles[1], record.speed, viewer.chain.size(),
+		areas_count, tick.explored_areas, tick.unexplored_areas, tick.resident_tiles, tick.paged_tiles, tick.stuck_count,
+		record.tick_time / 1000.0f, record.nav_mesh_time / 1000.0f, record.movement_time / 1000.0f, record.traces, record.expansions);
+
+	frame += stats;
+	std::fwrite(frame.data(), 1, frame.size(), stdout);
+	std::fflush(stdout);
+}
+
+static bool Receive(LocalSocket::Handle socket, Viewer& viewer)
+{
+	NavStreamFormat::MessageHeader header;
+
+	if (!ReceiveAll(socket, &header, sizeof(header)))
+		return false;
+
+	std::vector<uint8_t> payload(header.size);
+
+	if (!ReceiveAll(socket, payload.data(), payload.size()))
+		return false;
+
+	auto type = (NavStreamFormat::MessageType)header.type;
+
+	if (type == NavStreamFormat::MessageType::Hello)
+	{
+		NavStreamFormat::Hello hello;
+
+		if (payload.size() < sizeof(hello))
+			return false;
+
+		std::memcpy(&hello, payload.data(), sizeof(hello));
+
+		if (hello.magic != NavStreamFormat::Magic || hello.version != NavStreamFormat::Version)
+		{
+			std::fprintf(stderr, "nav_viewer: unsupported stream version %u\n", hello.version);
+			return false;
+		}
+
+		viewer.nav_step = hello.nav_step;
+	}
+	else if (type == NavStreamFormat::MessageType::Clear)
+	{
+		viewer.tiles.clear();
+		viewer.chain.clear();
+	}
+	else if (type == NavStreamFormat::MessageType::Tile)
+	{
+		NavStreamFormat::TileHeader tile;
+
+		if (payload.size() < sizeof(tile))
+			return false;
+
+		std::memcpy(&tile, payload.data(), sizeof(tile));
+
+		if (payload.size() != sizeof(tile) + tile.area_count * sizeof(NavStreamFormat::Area))
+			return false;
+
+		auto& areas = viewer.tiles[tile.key];
+		areas.resize(tile.area_count);
+		std::memcpy(areas.data(), payload.data() + sizeof(tile), areas.size() * sizeof(NavStreamFormat::Area));
+	}
+	else if (type == NavStreamFormat::MessageType::Chain)
+	{
+		uint32_t count;
+
+		if (payload.size() < sizeof(count))
+			return false;
+
+		std::memcpy(&count, payload.data(), sizeof(count));
+
+		if (payload.size() != sizeof(count) + count * sizeof(NavStreamFormat::Waypoint))
+			return false;
+
+		viewer.chain.resize(count);
+		std::memcpy(viewer.chain.data(), payload.data() + sizeof(count), viewer.chain.size() * sizeof(NavStreamFormat::Waypoint));
+	}
+	else if (type == NavStreamFormat::MessageType::Tick)
+	{
+		if (payload.size() != sizeof(viewer.tick))
+			return false;
+
+		std::memcpy(&viewer.tick, payload.data(), sizeof(viewer.tick));
+		viewer.has_tick = true;
+	}
+
+	// unknown messages are skipped, newer bots may send more
+
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::fprintf(stderr, "usage: nav_viewer <port> [cells_per_row]\n");
+		return 1;
+	}
+
+	auto port = std::atoi(argv[1]);
+	auto columns = argc > 2 ? std::max(std::atoi(argv[2]), 8) : 80;
+
+	LocalSocket::Startup();
+
+	auto socket = (LocalSocket::Handle)::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons((uint16_t)port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (socket == LocalSocket::Invalid || ::connect(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		std::fprintf(stderr, "nav_viewer: cannot connect to port %d\n", port);
+		return 1;
+	}
+
+	Viewer viewer;
+	auto render_interval = std::chrono::duration<float>(1.0f / RenderRate);
+	auto last_render = std::chrono::steady_clock::now() - render_interval;
+
+	while (Receive(socket, viewer))
+	{
+		auto now = std::chrono::steady_clock::now();
+
+		if (!viewer.has_tick || now - last_render < render_interval)
+			continue;
+
+		Render(viewer, columns);
+		last_render = now;
+	}
+
+	std::fprintf(stderr, "nav_viewer: stream closed\n");
+
+	LocalSocket::Close(socket);
+
+	return 0;
+}